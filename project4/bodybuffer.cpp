@@ -0,0 +1,215 @@
+// bodybuffer.cpp
+
+#include <string>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "bodybuffer.h"
+
+using namespace std;
+
+// limits from set_limits, 0 when off
+static size_t budget = 0;
+static size_t spill_size = 0;
+// heap capacity of every body, and bodies moved to files
+static atomic<size_t> heap_bytes(0);
+static atomic<uint64_t> spill_count(0);
+// fetchers waiting for the heap bytes to drop below the budget
+static mutex m_budget;
+static condition_variable cv_budget;
+
+static void charge(size_t n)
+{
+	heap_bytes.fetch_add(n, memory_order_relaxed);
+}
+
+static void refund(size_t n)
+{
+	size_t before = heap_bytes.fetch_sub(n, memory_order_relaxed);
+	// only wake the fetchers when this brought the bodies under budget
+	if (budget > 0 && before > budget && before - n <= budget)
+	{
+		unique_lock<mutex> lock(m_budget);
+		cv_budget.notify_all();
+	}
+}
+
+BodyBuffer::BodyBuffer()
+{
+	buf = NULL;
+	len = 0;
+	cap = 0;
+	fd = -1;
+}
+
+BodyBuffer::~BodyBuffer()
+{
+	release();
+}
+
+BodyBuffer::BodyBuffer(BodyBuffer &&other)
+{
+	buf = other.buf;
+	len = other.len;
+	cap = other.cap;
+	fd = other.fd;
+	other.buf = NULL;
+	other.len = 0;
+	other.cap = 0;
+	other.fd = -1;
+}
+
+BodyBuffer &BodyBuffer::operator=(BodyBuffer &&other)
+{
+	if (this != &other)
+	{
+		release();
+		buf = other.buf;
+		len = other.len;
+		cap = other.cap;
+		fd = other.fd;
+		other.buf = NULL;
+		other.len = 0;
+		other.cap = 0;
+		other.fd = -1;
+	}
+	return *this;
+}
+
+void BodyBuffer::release()
+{
+	/* gives back the heap block or the mapped file */
+	if (fd >= 0)
+	{
+		munmap(buf, cap);
+		close(fd);
+	}
+	else
+	{
+		free(buf);
+		refund(cap);
+	}
+}
+
+void BodyBuffer::reserve(size_t n)
+{
+	if (n <= cap)
+	{
+		return;
+	}
+	// large bodies go to a file rather than the heap
+	if ((fd >= 0 || (spill_size > 0 && n > spill_size)) && grow_file(n))
+	{
+		return;
+	}
+	// realloc can often extend large blocks in place instead of copying
+	char *grown = (char *)realloc(buf, n);
+	if (grown == NULL)
+	{
+		throw bad_alloc();
+	}
+	charge(n - cap);
+	buf = grown;
+	cap = n;
+}
+
+bool BodyBuffer::grow_file(size_t n)
+{
+	/* the file is unlinked at once, so it goes away with the body */
+
+	if (fd >= 0)
+	{
+		void *grown = MAP_FAILED;
+		if (ftruncate(fd, n) == 0)
+		{
+			grown = mremap(buf, cap, n, MREMAP_MAYMOVE);
+		}
+		if (grown == MAP_FAILED)
+		{
+			throw bad_alloc();
+		}
+		buf = (char *)grown;
+		cap = n;
+		return true;
+	}
+	const char *dir = getenv("TMPDIR");
+	string path = string(dir != NULL ? dir : "/tmp") + "/site-tester-body-XXXXXX";
+	int file = mkstemp(&path[0]);
+	if (file < 0)
+	{
+		return false;
+	}
+	unlink(path.c_str());
+	void *mapped = MAP_FAILED;
+	if (ftruncate(file, n) == 0)
+	{
+		mapped = mmap(NULL, n, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+	}
+	if (mapped == MAP_FAILED)
+	{
+		// keep the body on the heap instead
+		close(file);
+		return false;
+	}
+	if (len > 0)
+	{
+		memcpy(mapped, buf, len);
+	}
+	free(buf);
+	refund(cap);
+	buf = (char *)mapped;
+	cap = n;
+	fd = file;
+	spill_count.fetch_add(1, memory_order_relaxed);
+	return true;
+}
+
+void BodyBuffer::append(const char *contents, size_t n)
+{
+	if (len + n > cap)
+	{
+		// grow geometrically when Content-Length was missing or wrong
+		size_t want = cap < 16384 ? 16384 : cap * 2;
+		reserve(want < len + n ? len + n : want);
+	}
+	memcpy(buf + len, contents, n);
+	len += n;
+}
+
+void BodyBuffer::clear()
+{
+	len = 0;
+}
+
+void BodyBuffer::set_limits(size_t budget_bytes, size_t spill_bytes)
+{
+	budget = budget_bytes;
+	spill_size = spill_bytes;
+}
+
+bool BodyBuffer::over_budget()
+{
+	return budget > 0 && heap_bytes.load(memory_order_relaxed) > budget;
+}
+
+void BodyBuffer::wait_for_budget(int timeout_ms)
+{
+	unique_lock<mutex> lock(m_budget);
+	cv_budget.wait_for(lock, chrono::milliseconds(timeout_ms), []{ return !over_budget(); });
+}
+
+size_t BodyBuffer::in_memory()
+{
+	return heap_bytes.load(memory_order_relaxed);
+}
+
+uint64_t BodyBuffer::spilled()
+{
+	return spill_count.load(memory_order_relaxed);
+}
@@ -0,0 +1,60 @@
+// bodybuffer.h
+
+#ifndef BODYBUFFER_H
+#define BODYBUFFER_H
+
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+
+using namespace std;
+
+// a downloaded page; filled in bulk by the curl write callback and then only
+// moved between the fetch and parse stages, never copied.  Bodies larger
+// than the spill size live in an unlinked temporary file mapped into memory
+// instead of on the heap, and the heap bytes of all bodies together are
+// counted against a budget the fetchers wait on.
+class BodyBuffer
+{
+public:
+	BodyBuffer();
+	~BodyBuffer();
+	BodyBuffer(BodyBuffer &&other);
+	BodyBuffer &operator=(BodyBuffer &&other);
+	BodyBuffer(const BodyBuffer &) = delete;
+	BodyBuffer &operator=(const BodyBuffer &) = delete;
+
+	// grow capacity to at least n bytes, e.g. from Content-Length
+	void reserve(size_t n);
+	void append(const char *contents, size_t n);
+	void clear();
+
+	const char *data() const { return buf; }
+	size_t size() const { return len; }
+	bool empty() const { return len == 0; }
+	string str() const { return string(buf ? buf : "", len); }
+
+	// limits shared by every body, in bytes; 0 turns either off
+	static void set_limits(size_t budget, size_t spill_size);
+	// true while bodies on the heap take more than the budget
+	static bool over_budget();
+	// waits up to timeout_ms for the heap bytes to drop below the budget
+	static void wait_for_budget(int timeout_ms);
+	// heap bytes held by bodies, and bodies that went to a file
+	static size_t in_memory();
+	static uint64_t spilled();
+
+private:
+	// moves the body to a mapped file of n bytes or grows that file;
+	// false if the first move failed and the body stays on the heap
+	bool grow_file(size_t n);
+	void release();
+
+	char *buf;
+	size_t len;
+	size_t cap;
+	// the temporary file of a spilled body, -1 while on the heap
+	int fd;
+};
+
+#endif
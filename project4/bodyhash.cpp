@@ -0,0 +1,34 @@
+// bodyhash.cpp
+
+#include <string.h>
+#include "bodyhash.h"
+
+static inline uint64_t mix(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t body_hash(const char *data, size_t len)
+{
+	/* multiply-xor over 8 byte words, finished with a murmur3 style mix */
+	uint64_t h = 0x9e3779b97f4a7c15ULL ^ len;
+	size_t i = 0;
+	for (; i + 8 <= len; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, data + i, 8);
+		h = (h ^ mix(word)) * 0x9e3779b97f4a7c15ULL;
+	}
+	uint64_t tail = 0;
+	if (i < len)
+	{
+		memcpy(&tail, data + i, len - i);
+	}
+	h = (h ^ mix(tail)) * 0x9e3779b97f4a7c15ULL;
+	return mix(h);
+}
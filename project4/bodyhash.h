@@ -0,0 +1,12 @@
+// bodyhash.h
+
+#ifndef BODYHASH_H
+#define BODYHASH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// 64-bit hash of a body, eight bytes at a time
+uint64_t body_hash(const char *data, size_t len);
+
+#endif
@@ -0,0 +1,403 @@
+// config.cpp
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <algorithm>
+#include <thread>
+#include "config.h"
+
+using namespace std;
+
+tester_config parseConfig(string filename)
+{
+	/* reads KEY=VALUE lines from the configuration file */
+
+	tester_config cfg;
+	ifstream infile(filename);
+	string line;
+	string delimeter = "=";
+	// loop over configuration file for parameters
+	while (getline(infile,line))
+	{
+		string::size_type split = line.find(delimeter);
+		if (split == string::npos)
+		{
+			continue;
+		}
+		string key = line.substr(0,split);
+		string value = line.substr(split+1);
+		// period
+		if (key.compare("PERIOD_FETCH")==0)
+		{
+			cfg.period = stoi(value);
+			// enforce sensible input
+			if (cfg.period <= 0 || cfg.period > 500)
+			{
+				cfg.period = 180;
+			}
+		}
+		// number of fetch threads
+		else if (key.compare("NUM_FETCH")==0)
+		{
+			cfg.num_fetch = stoi(value);
+			// enforce sensible input
+			if (cfg.num_fetch <= 0 || cfg.num_fetch > 100)
+			{
+				cfg.num_fetch = 1;
+			}
+		}
+		// number of parse threads
+		else if (key.compare("NUM_PARSE")==0)
+		{
+			cfg.num_parse = stoi(value);
+			// enforce sensible input
+			if (cfg.num_parse <= 0 || cfg.num_parse > 100)
+			{
+				cfg.num_parse = 1;
+			}
+		}
+		// concurrent transfers driven by each fetch thread
+		else if (key.compare("MAX_INFLIGHT")==0)
+		{
+			cfg.max_inflight = stoi(value);
+			// enforce sensible input
+			if (cfg.max_inflight <= 0 || cfg.max_inflight > 1000)
+			{
+				cfg.max_inflight = 50;
+			}
+		}
+		// seconds to keep resolved host names
+		else if (key.compare("DNS_CACHE_TIMEOUT")==0)
+		{
+			cfg.dns_cache_timeout = stoi(value);
+			// enforce sensible input
+			if (cfg.dns_cache_timeout < 0)
+			{
+				cfg.dns_cache_timeout = 600;
+			}
+		}
+		// seconds to keep idle keep-alive connections
+		else if (key.compare("CONN_MAX_AGE")==0)
+		{
+			cfg.conn_max_age = stoi(value);
+			// enforce sensible input
+			if (cfg.conn_max_age < 0)
+			{
+				cfg.conn_max_age = 0;
+			}
+		}
+		// largest term list counted term by term with the vector kernel
+		else if (key.compare("SIMD_MAX_TERMS")==0)
+		{
+			cfg.simd_max_terms = stoi(value);
+			// enforce sensible input
+			if (cfg.simd_max_terms < 0)
+			{
+				cfg.simd_max_terms = 8;
+			}
+		}
+		// count while downloading instead of buffering bodies
+		else if (key.compare("STREAM_MATCH")==0)
+		{
+			cfg.stream_match = stoi(value) != 0;
+		}
+		// drop markup, scripts and styles before counting
+		else if (key.compare("HTML_TEXT")==0)
+		{
+			cfg.html_text = stoi(value) != 0;
+		}
+		// let servers compress bodies
+		else if (key.compare("COMPRESSION")==0)
+		{
+			cfg.compression = stoi(value) != 0;
+		}
+		// how long a shutdown waits for running transfers
+		else if (key.compare("SHUTDOWN_TIMEOUT")==0)
+		{
+			cfg.shutdown_timeout = stoi(value);
+			// enforce sensible input
+			if (cfg.shutdown_timeout < 0)
+			{
+				cfg.shutdown_timeout = 10;
+			}
+		}
+		// reload edited input files
+		else if (key.compare("WATCH_FILES")==0)
+		{
+			cfg.watch_files = stoi(value) != 0;
+		}
+		// bound the memory bodies take
+		else if (key.compare("MEMORY_BUDGET_MB")==0)
+		{
+			cfg.memory_budget_mb = stoi(value);
+			// enforce sensible input
+			if (cfg.memory_budget_mb < 0)
+			{
+				cfg.memory_budget_mb = 0;
+			}
+		}
+		else if (key.compare("BODY_SPILL_MB")==0)
+		{
+			cfg.body_spill_mb = stoi(value);
+			// enforce sensible input
+			if (cfg.body_spill_mb < 0)
+			{
+				cfg.body_spill_mb = 0;
+			}
+		}
+		// split the sites over several processes
+		else if (key.compare("SHARD_COUNT")==0)
+		{
+			cfg.shard_count = stoi(value);
+			// enforce sensible input
+			if (cfg.shard_count <= 0 || cfg.shard_count > 256)
+			{
+				cfg.shard_count = 1;
+			}
+		}
+		else if (key.compare("SHARD_INDEX")==0)
+		{
+			cfg.shard_index = stoi(value);
+		}
+		else if (key.compare("SHARD_SPAWN")==0)
+		{
+			cfg.shard_spawn = stoi(value) != 0;
+		}
+		else if (key.compare("RUN_START")==0)
+		{
+			cfg.run_start = stol(value);
+		}
+		// bounded queue sizes
+		else if (key.compare("FETCH_QUEUE_CAPACITY")==0)
+		{
+			cfg.fetch_queue_capacity = stoi(value);
+			// enforce sensible input
+			if (cfg.fetch_queue_capacity <= 0)
+			{
+				cfg.fetch_queue_capacity = 4096;
+			}
+		}
+		// fetches of one host allowed in flight at once
+		else if (key.compare("MAX_PER_HOST")==0)
+		{
+			cfg.max_per_host = stoi(value);
+			// enforce sensible input
+			if (cfg.max_per_host < 0)
+			{
+				cfg.max_per_host = 6;
+			}
+		}
+		else if (key.compare("PARSE_QUEUE_CAPACITY")==0)
+		{
+			cfg.parse_queue_capacity = stoi(value);
+			// enforce sensible input
+			if (cfg.parse_queue_capacity <= 0)
+			{
+				cfg.parse_queue_capacity = 64;
+			}
+		}
+		// spinning before blocking on a full or empty queue
+		else if (key.compare("QUEUE_SPIN")==0)
+		{
+			cfg.queue_spin = stoi(value);
+			// enforce sensible input
+			if (cfg.queue_spin < 0)
+			{
+				cfg.queue_spin = 64;
+			}
+		}
+		// result writer batching
+		else if (key.compare("FLUSH_BYTES")==0)
+		{
+			cfg.flush_bytes = stoi(value);
+			// enforce sensible input
+			if (cfg.flush_bytes <= 0)
+			{
+				cfg.flush_bytes = 1 << 20;
+			}
+		}
+		else if (key.compare("FLUSH_MS")==0)
+		{
+			cfg.flush_ms = stoi(value);
+			// enforce sensible input
+			if (cfg.flush_ms <= 0)
+			{
+				cfg.flush_ms = 1000;
+			}
+		}
+		// csv files, binary results log, or both
+		else if (key.compare("OUTPUT_FORMAT")==0)
+		{
+			cfg.output_format = value;
+			// enforce sensible input
+			if (value.compare("csv") != 0 && value.compare("binary") != 0 && value.compare("both") != 0)
+			{
+				cfg.output_format = "csv";
+			}
+		}
+		// binary results log file prefix
+		else if (key.compare("RESULT_LOG")==0)
+		{
+			cfg.result_log = value;
+		}
+		// spread fetches over the period instead of starting them together
+		else if (key.compare("SPREAD_FETCHES")==0)
+		{
+			cfg.spread_fetches = stoi(value) != 0;
+		}
+		// skip unchanged pages
+		else if (key.compare("CACHE")==0)
+		{
+			cfg.cache = stoi(value) != 0;
+		}
+		else if (key.compare("CACHE_FILE")==0)
+		{
+			cfg.cache_file = value;
+		}
+		// retries and circuit breaker for failed fetches
+		else if (key.compare("RETRY_MAX")==0)
+		{
+			cfg.retry_max = stoi(value);
+			// enforce sensible input
+			if (cfg.retry_max < 0)
+			{
+				cfg.retry_max = 5;
+			}
+		}
+		else if (key.compare("RETRY_BASE_MS")==0)
+		{
+			cfg.retry_base_ms = stoi(value);
+			// enforce sensible input
+			if (cfg.retry_base_ms <= 0)
+			{
+				cfg.retry_base_ms = 500;
+			}
+		}
+		else if (key.compare("RETRY_CAP_MS")==0)
+		{
+			cfg.retry_cap_ms = stoi(value);
+			// enforce sensible input
+			if (cfg.retry_cap_ms <= 0)
+			{
+				cfg.retry_cap_ms = 60000;
+			}
+		}
+		else if (key.compare("BREAKER_THRESHOLD")==0)
+		{
+			cfg.breaker_threshold = stoi(value);
+			// enforce sensible input
+			if (cfg.breaker_threshold <= 0)
+			{
+				cfg.breaker_threshold = 5;
+			}
+		}
+		else if (key.compare("BREAKER_COOLDOWN")==0)
+		{
+			cfg.breaker_cooldown = stoi(value);
+			// enforce sensible input
+			if (cfg.breaker_cooldown < 0)
+			{
+				cfg.breaker_cooldown = 60;
+			}
+		}
+		// pipeline metrics snapshot
+		else if (key.compare("STATS_FILE")==0)
+		{
+			cfg.stats_file = value;
+		}
+		else if (key.compare("STATS_PERIOD")==0)
+		{
+			cfg.stats_period = stoi(value);
+			// enforce sensible input
+			if (cfg.stats_period <= 0)
+			{
+				cfg.stats_period = 10;
+			}
+		}
+		// grow and shrink the thread pools between these sizes
+		else if (key.compare("AUTOSCALE")==0)
+		{
+			cfg.autoscale = stoi(value) != 0;
+		}
+		else if (key.compare("MIN_FETCH")==0)
+		{
+			cfg.min_fetch = stoi(value);
+			// enforce sensible input
+			if (cfg.min_fetch <= 0 || cfg.min_fetch > 100)
+			{
+				cfg.min_fetch = 1;
+			}
+		}
+		else if (key.compare("MAX_FETCH")==0)
+		{
+			cfg.max_fetch = stoi(value);
+			// enforce sensible input
+			if (cfg.max_fetch <= 0 || cfg.max_fetch > 100)
+			{
+				cfg.max_fetch = 16;
+			}
+		}
+		else if (key.compare("MIN_PARSE")==0)
+		{
+			cfg.min_parse = stoi(value);
+			// enforce sensible input
+			if (cfg.min_parse <= 0 || cfg.min_parse > 100)
+			{
+				cfg.min_parse = 1;
+			}
+		}
+		else if (key.compare("MAX_PARSE")==0)
+		{
+			cfg.max_parse = stoi(value);
+			// enforce sensible input
+			if (cfg.max_parse <= 0 || cfg.max_parse > 100)
+			{
+				cfg.max_parse = 16;
+			}
+		}
+		// fetch and parse on separate pools, or both on one work-stealing pool
+		else if (key.compare("EXECUTOR")==0)
+		{
+			cfg.executor = value;
+			// enforce sensible input
+			if (value.compare("pools") != 0 && value.compare("steal") != 0)
+			{
+				cfg.executor = "pools";
+			}
+		}
+		else if (key.compare("NUM_WORKERS")==0)
+		{
+			cfg.num_workers = stoi(value);
+			// enforce sensible input
+			if (cfg.num_workers < 0 || cfg.num_workers > 100)
+			{
+				cfg.num_workers = 0;
+			}
+		}
+		// search terms file name
+		else if (key.compare("SEARCH_FILE")==0)
+		{
+			cfg.search_file = value;
+		}
+		// searchable sites file name
+		else if (key.compare("SITE_FILE")==0)
+		{
+			cfg.site_file = value;
+		}
+	}
+	// pools start at NUM_FETCH/NUM_PARSE, kept within the autoscale limits
+	if (cfg.autoscale)
+	{
+		cfg.max_fetch = max(cfg.max_fetch, cfg.min_fetch);
+		cfg.max_parse = max(cfg.max_parse, cfg.min_parse);
+		cfg.num_fetch = min(max(cfg.num_fetch, cfg.min_fetch), cfg.max_fetch);
+		cfg.num_parse = min(max(cfg.num_parse, cfg.min_parse), cfg.max_parse);
+	}
+	if (cfg.num_workers == 0)
+	{
+		cfg.num_workers = max(1u, thread::hardware_concurrency());
+	}
+
+	return cfg;
+}
@@ -0,0 +1,62 @@
+// config.h
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <string>
+
+using namespace std;
+
+// options read from the configuration file passed to site-tester
+struct tester_config
+{
+	int period = 180; // seconds between queue fills
+	int num_fetch = 1; // fetch threads
+	int num_parse = 1; // parse threads
+	int max_inflight = 50; // concurrent transfers per fetch thread
+	int dns_cache_timeout = 600; // seconds resolved hosts are kept
+	int conn_max_age = 0; // seconds idle connections are kept, 0 for two periods
+	int simd_max_terms = 8; // term lists this short skip the automaton
+	bool stream_match = false; // count terms in the curl write callback
+	bool html_text = false; // count terms only in the visible text of pages
+	bool compression = true; // accept gzip, deflate and br bodies
+	int shutdown_timeout = 10; // seconds transfers get to finish on shutdown
+	bool watch_files = false; // reload the sites and search terms files when they change
+	int memory_budget_mb = 0; // bodies in memory that pause new fetches, 0 for no limit
+	int body_spill_mb = 0; // bodies larger than this go to a temporary file, 0 never
+	int shard_count = 1; // processes the sites are split over by host
+	int shard_index = -1; // the shard this worker fetches, -1 for the coordinator
+	bool shard_spawn = true; // the coordinator starts the workers itself
+	long run_start = 0; // unix time run 1 began, so shards number runs alike; 0 for now
+	int fetch_queue_capacity = 4096; // sites waiting for a fetch thread
+	int max_per_host = 6; // fetches of one host in flight at once, 0 for no limit
+	int parse_queue_capacity = 64; // bodies waiting for a parse thread
+	int queue_spin = 64; // failed tries before a full or empty queue blocks
+	int flush_bytes = 1 << 20; // buffered result bytes that trigger a write
+	int flush_ms = 1000; // longest time results stay buffered
+	string output_format = "csv"; // csv, binary or both
+	string result_log = "results"; // binary log file prefix
+	bool spread_fetches = true; // stagger first fetches over one period
+	bool cache = false; // conditional requests and body hash reuse
+	string cache_file = ""; // where the cache survives restarts
+	int retry_max = 5; // retries before a fetch is recorded as failed
+	int retry_base_ms = 500; // first retry waits up to this long
+	int retry_cap_ms = 60000; // longest wait between retries
+	int breaker_threshold = 5; // consecutive failures that open a host's breaker
+	int breaker_cooldown = 60; // seconds a host's fetches are shed
+	string stats_file = ""; // pipeline metrics snapshot, off when empty
+	int stats_period = 10; // seconds between metrics snapshots
+	bool autoscale = false; // resize the thread pools while running
+	int min_fetch = 1; // fewest fetch threads when autoscaling
+	int max_fetch = 16; // most fetch threads when autoscaling
+	int min_parse = 1; // fewest parse threads when autoscaling
+	int max_parse = 16; // most parse threads when autoscaling
+	string executor = "pools"; // separate fetch and parse pools, or steal
+	int num_workers = 0; // workers of the steal executor, 0 for one per core
+	string search_file = "Search.txt"; // search terms file
+	string site_file = "Sites.txt"; // searchable sites file
+};
+
+tester_config parseConfig(string filename);
+
+#endif
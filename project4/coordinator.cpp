@@ -0,0 +1,249 @@
+// coordinator.cpp
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <utility>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "coordinator.h"
+#include "resultwriter.h"
+
+using namespace std;
+
+// bytes of a shard's run file already merged, by (run, shard)
+typedef map<pair<int, int>, streamoff> merge_offsets;
+
+static string shard_dir(int shard)
+{
+	return "shard-" + to_string(shard);
+}
+
+static string absolute_path(const string &path)
+{
+	char resolved[PATH_MAX];
+	if (realpath(path.c_str(), resolved) == NULL)
+	{
+		return path;
+	}
+	return resolved;
+}
+
+static bool write_worker_config(const tester_config &cfg, const string &config_file, int shard, time_t run_start)
+{
+	/* the coordinator's configuration, with the input files found from the
+	 shard directory, the shard index and the common start of run 1 added;
+	 later lines win */
+
+	string dir = shard_dir(shard);
+	if (mkdir(dir.c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		return false;
+	}
+	ifstream in(config_file);
+	ofstream out(dir + "/Config.txt", ofstream::trunc);
+	out << in.rdbuf() << "\n";
+	out << "SEARCH_FILE=" << absolute_path(cfg.search_file) << "\n";
+	out << "SITE_FILE=" << absolute_path(cfg.site_file) << "\n";
+	out << "SHARD_INDEX=" << shard << "\n";
+	out << "RUN_START=" << run_start << "\n";
+	out.close();
+	return out.good();
+}
+
+static pid_t start_worker(const string &program, int shard, const sigset_t &mask)
+{
+	/* runs program on Config.txt in the shard's directory */
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		// the worker sets up its own signal handling
+		pthread_sigmask(SIG_SETMASK, &mask, NULL);
+		if (chdir(shard_dir(shard).c_str()) == 0)
+		{
+			execl(program.c_str(), program.c_str(), "Config.txt", (char *)NULL);
+		}
+		_exit(127);
+	}
+	return pid;
+}
+
+static void copy_rows(const string &from, int run, streamoff &offset, set<int> &runs)
+{
+	/* appends the whole rows a shard's run file gained since offset to the
+	 merged run file; a row still being written waits for the next call */
+
+	ifstream in(from, ifstream::binary);
+	in.seekg(0, ifstream::end);
+	streamoff size = in.tellg();
+	if (size <= offset)
+	{
+		return;
+	}
+	string rows(size - offset, '\0');
+	in.seekg(offset);
+	in.read(&rows[0], rows.size());
+	size_t last = rows.rfind('\n');
+	if (!in || last == string::npos)
+	{
+		return;
+	}
+	rows.resize(last + 1);
+	offset += rows.size();
+	// a run's merged file is started over the first time it is seen, as
+	// every shard's file is read from the beginning
+	string filename = to_string(run) + ".csv";
+	ofstream out;
+	if (runs.insert(run).second)
+	{
+		out.open(filename, ofstream::trunc);
+		out << csv_header;
+	}
+	else
+	{
+		out.open(filename, ofstream::app);
+	}
+	// every shard file starts with its own header
+	size_t pos = 0;
+	while (pos < rows.size())
+	{
+		size_t end = rows.find('\n', pos) + 1;
+		if (rows.compare(pos, end - pos, csv_header) != 0)
+		{
+			out.write(rows.data() + pos, end - pos);
+		}
+		pos = end;
+	}
+}
+
+static void merge_rows(int shards, merge_offsets &offsets, set<int> &runs)
+{
+	/* brings every merged <run>.csv up to date with the shards' run files */
+
+	for (int shard = 0; shard < shards; shard++)
+	{
+		string dir = shard_dir(shard);
+		DIR *listing = opendir(dir.c_str());
+		if (listing == NULL)
+		{
+			continue;
+		}
+		struct dirent *entry;
+		while ((entry = readdir(listing)) != NULL)
+		{
+			char *end;
+			long run = strtol(entry->d_name, &end, 10);
+			if (end == entry->d_name || strcmp(end, ".csv") != 0 || run <= 0)
+			{
+				continue;
+			}
+			copy_rows(dir + "/" + entry->d_name, run, offsets[make_pair(run, shard)], runs);
+		}
+		closedir(listing);
+	}
+}
+
+int run_coordinator(const tester_config &cfg, const string &config_file)
+{
+	/* starts the workers, merges their results and passes signals on */
+
+	// signals are taken with sigtimedwait between merges
+	sigset_t signals, old_mask;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &signals, &old_mask);
+
+	vector<pid_t> workers(cfg.shard_count, -1);
+	// every shard numbers its runs from the same moment
+	time_t run_start = cfg.run_start > 0 ? cfg.run_start : time(NULL);
+	if (cfg.shard_spawn)
+	{
+		// the worker is this same program, wherever it was started from
+		char self[PATH_MAX];
+		ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+		if (n <= 0)
+		{
+			cerr << "Error: cannot find the site-tester program to start shards with" << endl;
+			return 1;
+		}
+		self[n] = '\0';
+		for (int shard = 0; shard < cfg.shard_count; shard++)
+		{
+			if (!write_worker_config(cfg, config_file, shard, run_start))
+			{
+				cerr << "Error: cannot set up " << shard_dir(shard) << endl;
+				continue;
+			}
+			workers[shard] = start_worker(self, shard, old_mask);
+		}
+	}
+
+	merge_offsets offsets;
+	set<int> runs;
+	bool stopping = false;
+	while (1)
+	{
+		struct timespec tick = {1, 0};
+		int signum = sigtimedwait(&signals, NULL, &tick);
+		if (signum > 0)
+		{
+			// workers reload or shut down themselves
+			for (pid_t pid : workers)
+			{
+				if (pid > 0)
+				{
+					kill(pid, signum);
+				}
+			}
+			stopping = stopping || signum != SIGHUP;
+		}
+		int status;
+		pid_t pid;
+		while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+		{
+			for (int shard = 0; shard < cfg.shard_count; shard++)
+			{
+				if (workers[shard] != pid)
+				{
+					continue;
+				}
+				workers[shard] = -1;
+				// not restarted, a worker that failed once would fail again
+				if (!stopping)
+				{
+					cerr << "Error: shard " << shard << " exited, its sites are no longer fetched" << endl;
+				}
+			}
+		}
+		merge_rows(cfg.shard_count, offsets, runs);
+		bool running = false;
+		for (pid_t worker : workers)
+		{
+			running = running || worker > 0;
+		}
+		if (stopping && !running)
+		{
+			return 0;
+		}
+		if (cfg.shard_spawn && !running)
+		{
+			cerr << "Error: every shard has exited" << endl;
+			return 1;
+		}
+	}
+}
@@ -0,0 +1,23 @@
+// coordinator.h
+
+#ifndef COORDINATOR_H
+#define COORDINATOR_H
+
+#include <string>
+
+#include "config.h"
+
+using namespace std;
+
+// Runs site-tester as the coordinator of SHARD_COUNT worker processes.
+// Worker k runs in the directory shard-k with the same configuration plus
+// SHARD_INDEX=k, so it fetches only the sites whose host hashes to shard k
+// and writes its own <run>.csv files there.  The coordinator appends the new
+// rows of every shard's run files to its own <run>.csv files as they are
+// written, passes SIGHUP, SIGINT and SIGTERM on to the workers, and once they
+// have shut down merges whatever is left.  Without spawn the workers are
+// started elsewhere, e.g. on other hosts sharing the directory, and only the
+// merging happens here.  Returns the exit status.
+int run_coordinator(const tester_config &cfg, const string &config_file);
+
+#endif
@@ -0,0 +1,353 @@
+// curlmulti.cpp
+
+#include <string>
+#include <deque>
+#include <set>
+#include <vector>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include <curl/curl.h>
+
+#include "curlsingle.h"
+#include "curlmulti.h"
+#include "metrics.h"
+
+using namespace std;
+
+// largest Content-Length we trust enough to allocate up front
+static const size_t MAX_PRESIZE = 64 * 1024 * 1024;
+
+static string header_value(const char *buffer, size_t n, size_t skip)
+{
+	/* header value with surrounding whitespace and the line ending removed */
+	size_t b = skip;
+	while (b < n && (buffer[b] == ' ' || buffer[b] == '\t'))
+	{
+		b++;
+	}
+	size_t e = n;
+	while (e > b && (buffer[e-1] == '\r' || buffer[e-1] == '\n' || buffer[e-1] == ' '))
+	{
+		e--;
+	}
+	return string(buffer + b, e - b);
+}
+
+static size_t header_callback(char *buffer, size_t size, size_t nitems, void *userdata)
+{
+	/* pre-sizes the body from Content-Length so appends never reallocate,
+	 keeps the validators for conditional requests and starts the decoder
+	 for the body's Content-Encoding */
+
+	curl_transfer *t = (curl_transfer *)userdata;
+	size_t n = size * nitems;
+	static const char length_name[] = "content-length:";
+	static const char encoding_name[] = "content-encoding:";
+	static const char etag_name[] = "etag:";
+	static const char modified_name[] = "last-modified:";
+	// nothing may unwind through curl, a short count fails the transfer
+	try
+	{
+		if (n >= 5 && strncmp(buffer, "HTTP/", 5) == 0)
+		{
+			// a new response after a redirect, forget the last one's headers
+			t->etag.clear();
+			t->last_modified.clear();
+			t->encoding.clear();
+			t->length = 0;
+		}
+		else if (n <= 2 && (buffer[0] == '\r' || buffer[0] == '\n'))
+		{
+			// end of the headers, the body follows
+			t->decoder->start(t->encoding);
+			// an encoded body's Content-Length is its compressed size, so
+			// there the buffer grows as it decodes instead; a streamed body
+			// never uses the buffer
+			if (t->encoding.empty() && t->matcher == NULL)
+			{
+				t->body.reserve(t->length < MAX_PRESIZE ? t->length : MAX_PRESIZE);
+			}
+		}
+		else if (n > sizeof(length_name) - 1 && strncasecmp(buffer, length_name, sizeof(length_name) - 1) == 0)
+		{
+			t->length = strtoull(buffer + sizeof(length_name) - 1, NULL, 10);
+		}
+		else if (n > sizeof(encoding_name) - 1 && strncasecmp(buffer, encoding_name, sizeof(encoding_name) - 1) == 0)
+		{
+			t->encoding = header_value(buffer, n, sizeof(encoding_name) - 1);
+		}
+		else if (n > sizeof(etag_name) - 1 && strncasecmp(buffer, etag_name, sizeof(etag_name) - 1) == 0)
+		{
+			t->etag = header_value(buffer, n, sizeof(etag_name) - 1);
+		}
+		else if (n > sizeof(modified_name) - 1 && strncasecmp(buffer, modified_name, sizeof(modified_name) - 1) == 0)
+		{
+			t->last_modified = header_value(buffer, n, sizeof(modified_name) - 1);
+		}
+	}
+	catch (bad_alloc &)
+	{
+		return 0;
+	}
+	return n;
+}
+
+static void body_sink(const char *data, size_t len, void *userp)
+{
+	/* appends a piece of decoded body to the transfer's buffer */
+
+	curl_transfer *t = (curl_transfer *)userp;
+	t->body.append(data, len);
+	t->decoded += len;
+}
+
+static void stream_sink(const char *data, size_t len, void *userp)
+{
+	/* feeds a piece of decoded body straight to the matcher */
+
+	curl_transfer *t = (curl_transfer *)userp;
+	t->decoded += len;
+	if (t->html)
+	{
+		thread_local string text;
+		text.clear();
+		t->text.feed(data, len, text);
+		t->matcher->feed(t->match, text.data(), text.size());
+		return;
+	}
+	t->matcher->feed(t->match, data, len);
+}
+
+static size_t write_callback(char *contents, size_t size, size_t nmemb, void *userp)
+{
+	/* decodes a chunk into the body buffer, or into the matcher when
+	 streaming; a corrupt body fails the transfer */
+
+	curl_transfer *t = (curl_transfer *)userp;
+	decode_sink sink = t->matcher != NULL ? stream_sink : body_sink;
+	try
+	{
+		if (!t->decoder->feed(contents, size * nmemb, sink, t))
+		{
+			return 0;
+		}
+	}
+	catch (bad_alloc &)
+	{
+		// a short count makes curl fail the transfer
+		return 0;
+	}
+	return size * nmemb;
+}
+
+CurlMulti::CurlMulti(int max_inflight, bool html_text, bool compression)
+{
+	multi = curl_multi_init();
+	this->html_text = html_text;
+	this->compression = compression;
+	limit = max_inflight;
+	// idle connections kept open between fetch cycles
+	curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, (long)max_inflight * 4);
+	running = 0;
+}
+
+CurlMulti::~CurlMulti()
+{
+	// abandon anything still running
+	for (CURL *curl_handle : handles)
+	{
+		curl_transfer *t;
+		curl_easy_getinfo(curl_handle, CURLINFO_PRIVATE, (char **)&t);
+		curl_multi_remove_handle(multi, curl_handle);
+		curl_easy_cleanup(curl_handle);
+		curl_slist_free_all(t->headers);
+		delete t->decoder;
+		delete t;
+	}
+	for (CURL *curl_handle : idle)
+	{
+		curl_easy_cleanup(curl_handle);
+	}
+	for (Decoder *decoder : spare_decoders)
+	{
+		delete decoder;
+	}
+	curl_multi_cleanup(multi);
+}
+
+void CurlMulti::add(const fetch_data &src, time_t fetchtime, shared_ptr<const Matcher> stream_matcher)
+{
+	/* queues a new transfer on the multi handle */
+
+	curl_transfer *t = new curl_transfer;
+	t->src = src;
+	t->fetchtime = fetchtime;
+	t->ok = false;
+	t->status = 0;
+	t->matcher = stream_matcher;
+	t->html = html_text;
+	t->headers = NULL;
+	t->length = 0;
+	t->decoded = 0;
+	// decoders keep their state between transfers
+	if (!spare_decoders.empty())
+	{
+		t->decoder = spare_decoders.back();
+		spare_decoders.pop_back();
+	}
+	else
+	{
+		t->decoder = new Decoder;
+	}
+	// a body without headers, e.g. from file://, is never encoded
+	t->decoder->start("");
+	// ask for the page only if it changed since the last fetch
+	if (!src.if_none_match.empty())
+	{
+		t->headers = curl_slist_append(t->headers, ("If-None-Match: " + src.if_none_match).c_str());
+	}
+	if (!src.if_modified_since.empty())
+	{
+		t->headers = curl_slist_append(t->headers, ("If-Modified-Since: " + src.if_modified_since).c_str());
+	}
+
+	// reuse a finished handle when there is one
+	CURL *curl_handle;
+	if (!idle.empty())
+	{
+		curl_handle = idle.back();
+		idle.pop_back();
+	}
+	else
+	{
+		curl_handle = curl_easy_init();
+	}
+	curl_setup_handle(curl_handle, src.source);
+	if (t->matcher != NULL)
+	{
+		// count chunks as they arrive
+		t->matcher->start(t->match);
+	}
+	// decode into the transfer's body buffer or the matcher
+	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, write_callback);
+	curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, t);
+	// curl would decode into its own buffers first, we do it in the callback
+	curl_easy_setopt(curl_handle, CURLOPT_ACCEPT_ENCODING, compression ? Decoder::accepted() : NULL);
+	curl_easy_setopt(curl_handle, CURLOPT_HTTP_CONTENT_DECODING, 0L);
+	curl_easy_setopt(curl_handle, CURLOPT_HEADERFUNCTION, header_callback);
+	curl_easy_setopt(curl_handle, CURLOPT_HEADERDATA, t);
+	curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, t->headers);
+	// remember which transfer this handle belongs to
+	curl_easy_setopt(curl_handle, CURLOPT_PRIVATE, t);
+	curl_multi_add_handle(multi, curl_handle);
+	handles.insert(curl_handle);
+	running++;
+}
+
+void CurlMulti::perform(int timeout_ms)
+{
+	/* drives all transfers until something finishes or timeout_ms passes */
+
+	int still_running;
+	curl_multi_perform(multi, &still_running);
+	collect();
+	// nothing finished yet, sleep until there is socket activity
+	if (finished.empty() && running > 0)
+	{
+		curl_multi_poll(multi, NULL, 0, timeout_ms, NULL);
+		curl_multi_perform(multi, &still_running);
+		collect();
+	}
+}
+
+bool CurlMulti::next_done(curl_transfer &done)
+{
+	if (finished.empty())
+	{
+		return false;
+	}
+	done = move(finished.front());
+	finished.pop_front();
+	return true;
+}
+
+void CurlMulti::record_timings(CURL *curl_handle, bool ok)
+{
+	/* splits curl's cumulative timings into per-phase histograms */
+
+	if (!ok)
+	{
+		metrics.fetches_failed.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+	curl_off_t dns = 0, connect = 0, tls = 0, ttfb = 0, total = 0, size = 0;
+	curl_easy_getinfo(curl_handle, CURLINFO_NAMELOOKUP_TIME_T, &dns);
+	curl_easy_getinfo(curl_handle, CURLINFO_CONNECT_TIME_T, &connect);
+	curl_easy_getinfo(curl_handle, CURLINFO_APPCONNECT_TIME_T, &tls);
+	curl_easy_getinfo(curl_handle, CURLINFO_STARTTRANSFER_TIME_T, &ttfb);
+	curl_easy_getinfo(curl_handle, CURLINFO_TOTAL_TIME_T, &total);
+	curl_easy_getinfo(curl_handle, CURLINFO_SIZE_DOWNLOAD_T, &size);
+	// appconnect stays 0 for plain http
+	curl_off_t ready = tls > connect ? tls : connect;
+	metrics.dns.record(dns);
+	metrics.connect.record(connect > dns ? connect - dns : 0);
+	if (tls > 0)
+	{
+		metrics.tls.record(tls > connect ? tls - connect : 0);
+	}
+	metrics.ttfb.record(ttfb > ready ? ttfb - ready : 0);
+	metrics.transfer.record(total > ttfb ? total - ttfb : 0);
+	metrics.bytes.fetch_add(size, memory_order_relaxed);
+	metrics.fetches_ok.fetch_add(1, memory_order_relaxed);
+}
+
+void CurlMulti::collect()
+{
+	/* moves completed transfers from the multi handle to the finished list */
+
+	CURLMsg *msg;
+	int msgs_left;
+	while ((msg = curl_multi_info_read(multi, &msgs_left)) != NULL)
+	{
+		if (msg->msg != CURLMSG_DONE)
+		{
+			continue;
+		}
+		CURL *curl_handle = msg->easy_handle;
+		curl_transfer *t;
+		curl_easy_getinfo(curl_handle, CURLINFO_PRIVATE, (char **)&t);
+		// a compressed body that stopped short is as bad as a failed transfer
+		t->ok = (msg->data.result == CURLE_OK) && t->decoder->finish();
+		curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &t->status);
+		spare_decoders.push_back(t->decoder);
+		t->decoder = NULL;
+		record_timings(curl_handle, t->ok);
+		if (t->ok)
+		{
+			metrics.decoded_bytes.fetch_add(t->decoded, memory_order_relaxed);
+		}
+		curl_slist_free_all(t->headers);
+		t->headers = NULL;
+		if (t->ok && t->matcher != NULL)
+		{
+			if (t->html)
+			{
+				string text;
+				t->text.finish(text);
+				t->matcher->feed(t->match, text.data(), text.size());
+			}
+			t->counts = t->matcher->finish(t->match);
+		}
+		// msg is invalid once the handle is removed
+		curl_multi_remove_handle(multi, curl_handle);
+		handles.erase(curl_handle);
+		// keep the handle for the next transfer
+		idle.push_back(curl_handle);
+		finished.push_back(move(*t));
+		delete t;
+		running--;
+	}
+}
@@ -0,0 +1,93 @@
+// curlmulti.h
+
+#ifndef CURLMULTI_H
+#define CURLMULTI_H
+
+#include <string>
+#include <deque>
+#include <set>
+#include <vector>
+#include <memory>
+#include <time.h>
+
+#include <curl/curl.h>
+
+#include "sitedata.h"
+#include "bodybuffer.h"
+#include "matcher.h"
+#include "htmltext.h"
+#include "decoder.h"
+
+using namespace std;
+
+// a finished transfer handed back to the fetch thread
+struct curl_transfer
+{
+	fetch_data src;
+	time_t fetchtime;
+	BodyBuffer body;
+	bool ok;
+	long status;
+	// validators from the response headers
+	string etag;
+	string last_modified;
+	struct curl_slist *headers;
+	// Content-Encoding and Content-Length of the response being received
+	string encoding;
+	size_t length;
+	// borrowed from the engine while the transfer runs
+	Decoder *decoder;
+	// body bytes after decoding
+	size_t decoded;
+	// streaming mode: the body is counted as it arrives and never kept,
+	// with the terms that were current when the transfer started
+	shared_ptr<const Matcher> matcher;
+	match_stream match;
+	vector<int> counts;
+	// streaming mode with html_text: markup is dropped before counting
+	bool html;
+	HtmlText text;
+};
+
+// drives many concurrent transfers from one thread with the curl multi interface
+class CurlMulti
+{
+public:
+	// streamed transfers are counted only in the visible text when
+	// html_text is set; with compression servers may send gzip, deflate or
+	// br bodies, which are decoded as they arrive
+	CurlMulti(int max_inflight, bool html_text = false, bool compression = true);
+	~CurlMulti();
+
+	// number of transfers currently running
+	int inflight() const { return running; }
+	// true once max_inflight transfers are running
+	bool full() const { return running >= limit; }
+
+	// start fetching src; fetchtime is reported back with the body, which
+	// is counted by stream_matcher while it downloads instead of being
+	// buffered when one is given
+	void add(const fetch_data &src, time_t fetchtime, shared_ptr<const Matcher> stream_matcher = nullptr);
+	// run transfers, waiting up to timeout_ms for network activity
+	void perform(int timeout_ms);
+	// pop the next finished transfer, false when there are none
+	bool next_done(curl_transfer &done);
+
+private:
+	void collect();
+	// curl phase timings and byte counts go to the global metrics
+	void record_timings(CURL *curl_handle, bool ok);
+
+	CURLM *multi;
+	bool html_text;
+	bool compression;
+	int limit;
+	int running;
+	set<CURL *> handles;
+	vector<CURL *> idle;
+	// decoders of finished transfers, ready for the next ones
+	vector<Decoder *> spare_decoders;
+	deque<curl_transfer> finished;
+};
+
+#endif
@@ -0,0 +1,65 @@
+// curlshare.cpp
+
+#include <mutex>
+
+#include <curl/curl.h>
+
+#include "curlshare.h"
+
+using namespace std;
+
+// the share object and one mutex for each kind of data it holds
+static CURLSH *share = NULL;
+static mutex share_locks[CURL_LOCK_DATA_LAST];
+static long share_dns_timeout = 60;
+static long share_max_age = 118;
+
+static void share_lock(CURL *handle, curl_lock_data data, curl_lock_access access, void *userptr)
+{
+	share_locks[data].lock();
+}
+
+static void share_unlock(CURL *handle, curl_lock_data data, void *userptr)
+{
+	share_locks[data].unlock();
+}
+
+void curl_share_setup(long dns_timeout, long max_age)
+{
+	/* sets up caches that outlive individual transfers and fetch cycles */
+
+	share_dns_timeout = dns_timeout;
+	share_max_age = max_age;
+	share = curl_share_init();
+	curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+	curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+	// resolved addresses
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+	// TLS session tickets so reconnects skip the full handshake
+	curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+	// connections are not shared: every fetch thread's multi handle keeps
+	// its own pool, which libcurl does not allow to be used across threads
+}
+
+void curl_share_attach(CURL *curl_handle)
+{
+	if (share == NULL)
+	{
+		return;
+	}
+	curl_easy_setopt(curl_handle, CURLOPT_SHARE, share);
+	// keep addresses across fetch cycles
+	curl_easy_setopt(curl_handle, CURLOPT_DNS_CACHE_TIMEOUT, share_dns_timeout);
+	// keep idle connections until the next cycle wants them
+	curl_easy_setopt(curl_handle, CURLOPT_MAXAGE_CONN, share_max_age);
+	curl_easy_setopt(curl_handle, CURLOPT_TCP_KEEPALIVE, 1L);
+}
+
+void curl_share_teardown()
+{
+	if (share != NULL)
+	{
+		curl_share_cleanup(share);
+		share = NULL;
+	}
+}
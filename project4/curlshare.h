@@ -0,0 +1,18 @@
+// curlshare.h
+
+#ifndef CURLSHARE_H
+#define CURLSHARE_H
+
+#include <curl/curl.h>
+
+// creates the share object every fetch thread uses for its DNS cache and TLS
+// sessions; keep-alive connections stay in each thread's multi handle.
+// dns_timeout and max_age in seconds
+void curl_share_setup(long dns_timeout, long max_age);
+
+// attaches a transfer to the share object
+void curl_share_attach(CURL *curl_handle);
+
+void curl_share_teardown();
+
+#endif
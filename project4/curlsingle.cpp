@@ -1,40 +1,18 @@
 //curlsingle.cpp
 
-#include <iostream>
 #include <string>
 
 #include <curl/curl.h>
 
-using namespace std;
-
-size_t CurlSingleWriteFunction(char *contents, size_t size, size_t nmemb, string *resultptr) {
-	for (size_t c = 0; c<size*nmemb; c++) {
-		resultptr->push_back(contents[c]);
-	}
-	
-	return size*nmemb;
-}
-
-string curl_url(string url) {
-	CURL *curl_handle;
-	CURLcode res;
- 
-	string result;
- 
-	curl_global_init(CURL_GLOBAL_ALL);
+#include "curlsingle.h"
+#include "curlshare.h"
 
-	/* init the curl session */ 
-	curl_handle = curl_easy_init();
+using namespace std;
 
+void curl_setup_handle(CURL *curl_handle, string url) {
 	/* specify URL to get */ 
 	curl_easy_setopt(curl_handle, CURLOPT_URL, url.c_str());
 
-	/* send all data to this function  */ 
-	curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, CurlSingleWriteFunction);
-
-	/* we pass our 'chunk' struct to the callback function */ 
-	curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, &result);
-
 	/* some servers don't like requests that are made without a user-agent
 	 field, so we provide one */ 
 	curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "libcurl-agent/1.0");
@@ -45,19 +23,9 @@ string curl_url(string url) {
 	/* set option to timeout after 5 minutes */
 	curl_easy_setopt(curl_handle, CURLOPT_CONNECTTIMEOUT, 300);
 
-	/* get it! */ 
-	res = curl_easy_perform(curl_handle);
-
-	/* check for errors */ 
-	if(res != CURLE_OK) {
-		result = "failure";
-	}
- 
-	/* cleanup curl stuff */ 
-	curl_easy_cleanup(curl_handle);
-	 
-	/* we're done with libcurl, so clean it up */ 
-	curl_global_cleanup();
- 
-	return result;
+	/* no signals, we run from many threads */
+	curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1L);
+
+	/* reuse DNS, TLS sessions and connections from earlier transfers */
+	curl_share_attach(curl_handle);
 }
@@ -2,9 +2,9 @@
 
 #include <string>
 
-using namespace std;
+#include <curl/curl.h>
 
-size_t CurlSingleWriteFunction(char *contents, size_t size, size_t 
-nmenb, string *resultsptr);
+using namespace std;
 
-string curl_url(string url);
+// options shared by every transfer; the caller sets the write callback
+void curl_setup_handle(CURL *curl_handle, string url);
@@ -0,0 +1,234 @@
+// decoder.cpp
+
+#include <string>
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include <zlib.h>
+#include <brotli/decode.h>
+
+#include "decoder.h"
+
+using namespace std;
+
+// decoded bytes handed to the sink at a time, as large as a curl chunk
+static const size_t WINDOW = 16384;
+
+Decoder::Decoder()
+{
+	coding = IDENTITY;
+	ok = true;
+	done = false;
+	fresh = true;
+	raw = false;
+	zlib_ready = false;
+	brotli = NULL;
+	window = (char *)malloc(WINDOW);
+	if (window == NULL)
+	{
+		throw bad_alloc();
+	}
+}
+
+Decoder::~Decoder()
+{
+	if (zlib_ready)
+	{
+		inflateEnd(&zs);
+	}
+	if (brotli != NULL)
+	{
+		BrotliDecoderDestroyInstance(brotli);
+	}
+	free(window);
+}
+
+const char *Decoder::accepted()
+{
+	return "gzip, deflate, br";
+}
+
+bool Decoder::start(const string &encoding)
+{
+	/* picks the decoder for the next body, keeping the zlib state */
+
+	string name;
+	for (char c : encoding)
+	{
+		if (!isspace((unsigned char)c))
+		{
+			name += tolower((unsigned char)c);
+		}
+	}
+	ok = true;
+	done = false;
+	fresh = true;
+	raw = false;
+	if (name.empty() || name.compare("identity") == 0)
+	{
+		coding = IDENTITY;
+	}
+	else if (name.compare("gzip") == 0 || name.compare("x-gzip") == 0 || name.compare("deflate") == 0)
+	{
+		coding = ZLIB;
+		// 15 + 32: the largest window, and a gzip or zlib header detected
+		if (!zlib_ready)
+		{
+			zs.zalloc = Z_NULL;
+			zs.zfree = Z_NULL;
+			zs.opaque = Z_NULL;
+			zs.next_in = Z_NULL;
+			zs.avail_in = 0;
+			if (inflateInit2(&zs, 15 + 32) != Z_OK)
+			{
+				throw bad_alloc();
+			}
+			zlib_ready = true;
+		}
+		else
+		{
+			inflateReset2(&zs, 15 + 32);
+		}
+	}
+	else if (name.compare("br") == 0)
+	{
+		coding = BROTLI;
+		// this brotli has no reset, a fresh state is the only way to start over
+		if (brotli != NULL)
+		{
+			BrotliDecoderDestroyInstance(brotli);
+		}
+		brotli = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+		if (brotli == NULL)
+		{
+			throw bad_alloc();
+		}
+	}
+	else
+	{
+		// stacked or unknown codings; we never ask for them
+		coding = IDENTITY;
+		ok = false;
+	}
+	return ok;
+}
+
+bool Decoder::feed(const char *data, size_t len, decode_sink sink, void *userp)
+{
+	if (!ok)
+	{
+		return false;
+	}
+	if (coding == IDENTITY)
+	{
+		sink(data, len, userp);
+		fresh = false;
+		return true;
+	}
+	if (done || len == 0)
+	{
+		// anything after the end of the compressed stream is ignored
+		return true;
+	}
+	ok = coding == ZLIB ? feed_zlib(data, len, sink, userp) : feed_brotli(data, len, sink, userp);
+	fresh = false;
+	return ok;
+}
+
+bool Decoder::finish()
+{
+	return ok && (coding == IDENTITY || fresh || done);
+}
+
+bool Decoder::feed_zlib(const char *data, size_t len, decode_sink sink, void *userp)
+{
+	/* inflates one chunk; deflate bodies without the zlib header are
+	 inflated again from the start as raw deflate */
+
+	size_t before = zs.total_in;
+	int r = inflate_chunk((const Bytef *)data, len, sink, userp);
+	if (r == Z_DATA_ERROR && !raw && zs.total_out == 0 && before <= sizeof(lead))
+	{
+		// a bad header shows within its first two bytes, which are kept
+		raw = true;
+		inflateReset2(&zs, -15);
+		r = inflate_chunk(lead, before, sink, userp);
+		if (r == Z_OK)
+		{
+			r = inflate_chunk((const Bytef *)data, len, sink, userp);
+		}
+	}
+	if (zs.total_in <= sizeof(lead))
+	{
+		memcpy(lead + before, data, zs.total_in - before);
+	}
+	return r != Z_DATA_ERROR;
+}
+
+int Decoder::inflate_chunk(const Bytef *data, size_t len, decode_sink sink, void *userp)
+{
+	/* inflates len bytes, a window of output at a time; Z_OK when more
+	 input is wanted, Z_STREAM_END at the end and Z_DATA_ERROR otherwise */
+
+	zs.next_in = (Bytef *)data;
+	zs.avail_in = len;
+	while (true)
+	{
+		zs.next_out = (Bytef *)window;
+		zs.avail_out = WINDOW;
+		int r = inflate(&zs, Z_NO_FLUSH);
+		size_t produced = WINDOW - zs.avail_out;
+		if (produced > 0)
+		{
+			sink(window, produced, userp);
+		}
+		if (r == Z_STREAM_END)
+		{
+			done = true;
+			return r;
+		}
+		if (r == Z_BUF_ERROR || (r == Z_OK && zs.avail_in == 0 && zs.avail_out > 0))
+		{
+			// no progress possible until the next chunk
+			return Z_OK;
+		}
+		if (r != Z_OK)
+		{
+			return Z_DATA_ERROR;
+		}
+	}
+}
+
+bool Decoder::feed_brotli(const char *data, size_t len, decode_sink sink, void *userp)
+{
+	/* decompresses one chunk, a window of output at a time */
+
+	const uint8_t *next_in = (const uint8_t *)data;
+	size_t avail_in = len;
+	while (true)
+	{
+		uint8_t *next_out = (uint8_t *)window;
+		size_t avail_out = WINDOW;
+		BrotliDecoderResult r = BrotliDecoderDecompressStream(brotli, &avail_in, &next_in, &avail_out, &next_out, NULL);
+		if (avail_out < WINDOW)
+		{
+			sink(window, WINDOW - avail_out, userp);
+		}
+		if (r == BROTLI_DECODER_RESULT_SUCCESS)
+		{
+			done = true;
+			return true;
+		}
+		if (r == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT)
+		{
+			return true;
+		}
+		if (r == BROTLI_DECODER_RESULT_ERROR)
+		{
+			return false;
+		}
+		// NEEDS_MORE_OUTPUT: go round with an empty window
+	}
+}
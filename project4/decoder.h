@@ -0,0 +1,61 @@
+// decoder.h
+
+#ifndef DECODER_H
+#define DECODER_H
+
+#include <string>
+#include <stddef.h>
+
+#include <zlib.h>
+#include <brotli/decode.h>
+
+using namespace std;
+
+// receives each piece of decoded body
+typedef void (*decode_sink)(const char *data, size_t len, void *userp);
+
+// Streaming Content-Encoding decoder for gzip, deflate and br bodies.  Output
+// goes to the sink a window at a time, so a body is never held both encoded
+// and decoded.  One decoder is meant to serve many bodies in turn: the zlib
+// state and the output window are kept between them.
+class Decoder
+{
+public:
+	Decoder();
+	~Decoder();
+	Decoder(const Decoder &) = delete;
+	Decoder &operator=(const Decoder &) = delete;
+
+	// the Content-Encoding a client can ask for
+	static const char *accepted();
+
+	// start a new body with the given Content-Encoding; empty or identity
+	// passes data through untouched, false for a coding we cannot decode
+	bool start(const string &encoding);
+	// false when the data is corrupt
+	bool feed(const char *data, size_t len, decode_sink sink, void *userp);
+	// false when the body stopped before the end of its compressed stream
+	bool finish();
+
+private:
+	enum { IDENTITY, ZLIB, BROTLI };
+
+	bool feed_zlib(const char *data, size_t len, decode_sink sink, void *userp);
+	int inflate_chunk(const Bytef *data, size_t len, decode_sink sink, void *userp);
+	bool feed_brotli(const char *data, size_t len, decode_sink sink, void *userp);
+
+	int coding;
+	bool ok;
+	bool done;
+	// nothing has been fed since start
+	bool fresh;
+	bool zlib_ready;
+	z_stream zs;
+	// retrying as raw deflate, and the first bytes of the body to retry with
+	bool raw;
+	Bytef lead[2];
+	BrotliDecoderState *brotli;
+	char *window;
+};
+
+#endif
@@ -0,0 +1,153 @@
+// fetchcache.cpp
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <stdio.h>
+#include "fetchcache.h"
+#include "bodyhash.h"
+
+using namespace std;
+
+cache_entry *FetchCache::usable(const string &url, uint64_t terms_id, size_t num_terms)
+{
+	/* the entry for url if its counts fit the current term list; an entry
+	 made for this list but with the wrong number of counts is corrupt and
+	 is dropped so its validators are not sent again */
+
+	unordered_map<string, cache_entry>::iterator it = entries.find(url);
+	if (it == entries.end() || it->second.terms_id != terms_id)
+	{
+		return NULL;
+	}
+	if (it->second.counts.size() != num_terms)
+	{
+		entries.erase(it);
+		return NULL;
+	}
+	return &it->second;
+}
+
+void FetchCache::conditional(fetch_data &src, uint64_t terms_id, size_t num_terms)
+{
+	unique_lock<mutex> lock(m_entries);
+	cache_entry *entry = usable(src.source, terms_id, num_terms);
+	if (entry == NULL)
+	{
+		return;
+	}
+	src.if_none_match = entry->etag;
+	src.if_modified_since = entry->last_modified;
+}
+
+bool FetchCache::counts(const string &url, uint64_t terms_id, size_t num_terms, vector<int> &counts)
+{
+	unique_lock<mutex> lock(m_entries);
+	cache_entry *entry = usable(url, terms_id, num_terms);
+	if (entry == NULL)
+	{
+		return false;
+	}
+	counts = entry->counts;
+	return true;
+}
+
+bool FetchCache::unchanged(const string &url, uint64_t hash, uint64_t terms_id, size_t num_terms,
+	vector<int> &counts)
+{
+	unique_lock<mutex> lock(m_entries);
+	cache_entry *entry = usable(url, terms_id, num_terms);
+	if (entry == NULL || entry->hash != hash)
+	{
+		return false;
+	}
+	counts = entry->counts;
+	return true;
+}
+
+void FetchCache::store(const string &url, const cache_entry &entry)
+{
+	unique_lock<mutex> lock(m_entries);
+	entries[url] = entry;
+}
+
+bool FetchCache::load(const string &filename)
+{
+	/* one tab separated line per url:
+	 url, etag, last-modified, hash, terms id, comma separated counts */
+
+	ifstream infile(filename);
+	if (!infile.good())
+	{
+		return false;
+	}
+	unique_lock<mutex> lock(m_entries);
+	string line;
+	while (getline(infile, line))
+	{
+		vector<string> fields;
+		istringstream split(line);
+		string field;
+		while (getline(split, field, '\t'))
+		{
+			fields.push_back(field);
+		}
+		if (fields.size() < 5)
+		{
+			continue;
+		}
+		cache_entry entry;
+		entry.etag = fields[1];
+		entry.last_modified = fields[2];
+		try
+		{
+			entry.hash = stoull(fields[3]);
+			entry.terms_id = stoull(fields[4]);
+			if (fields.size() > 5)
+			{
+				istringstream values(fields[5]);
+				string value;
+				while (getline(values, value, ','))
+				{
+					entry.counts.push_back(stoi(value));
+				}
+			}
+		}
+		catch (logic_error &)
+		{
+			// a corrupt or truncated line; that site is fetched afresh
+			continue;
+		}
+		entries[fields[0]] = entry;
+	}
+	return true;
+}
+
+bool FetchCache::save(const string &filename)
+{
+	/* written to a temporary file and renamed so a crash keeps the old cache */
+
+	string tmpname = filename + ".tmp";
+	ofstream outfile(tmpname, ofstream::out | ofstream::trunc);
+	if (!outfile.good())
+	{
+		return false;
+	}
+	unique_lock<mutex> lock(m_entries);
+	for (auto &e : entries)
+	{
+		outfile << e.first << '\t' << e.second.etag << '\t' << e.second.last_modified << '\t'
+			<< e.second.hash << '\t' << e.second.terms_id << '\t';
+		for (size_t t = 0; t < e.second.counts.size(); t++)
+		{
+			outfile << (t ? "," : "") << e.second.counts[t];
+		}
+		outfile << '\n';
+	}
+	lock.unlock();
+	outfile.close();
+	return rename(tmpname.c_str(), filename.c_str()) == 0;
+}
@@ -0,0 +1,55 @@
+// fetchcache.h
+
+#ifndef FETCHCACHE_H
+#define FETCHCACHE_H
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "sitedata.h"
+
+using namespace std;
+
+// what we know about a url from its last fetch
+struct cache_entry
+{
+	string etag;
+	string last_modified;
+	uint64_t hash = 0;
+	// counts are only valid for the term list they were made with
+	uint64_t terms_id = 0;
+	vector<int> counts;
+};
+
+// Remembers validators, a body hash and the term counts for every url so
+// unchanged pages can be answered with 304 or recognised by hash and skip
+// parsing.  Shared by all fetch and parse threads.
+class FetchCache
+{
+public:
+	// fills in the conditional request headers for src, but only when the
+	// stored counts can be reused for terms_id and its num_terms terms
+	void conditional(fetch_data &src, uint64_t terms_id, size_t num_terms);
+	// stored counts for url made with terms_id; false if there are none
+	bool counts(const string &url, uint64_t terms_id, size_t num_terms, vector<int> &counts);
+	// stored counts if the body hash is unchanged; false if it differs
+	bool unchanged(const string &url, uint64_t hash, uint64_t terms_id, size_t num_terms,
+		vector<int> &counts);
+	void store(const string &url, const cache_entry &entry);
+
+	// keeps the cache across restarts
+	bool load(const string &filename);
+	bool save(const string &filename);
+
+private:
+	cache_entry *usable(const string &url, uint64_t terms_id, size_t num_terms);
+
+	mutex m_entries;
+	unordered_map<string, cache_entry> entries;
+};
+
+#endif
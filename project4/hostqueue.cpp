@@ -0,0 +1,136 @@
+// hostqueue.cpp
+
+#include <string>
+#include <deque>
+#include <chrono>
+#include "hostqueue.h"
+#include "parse.h"
+
+using namespace std;
+
+HostQueue::HostQueue(size_t capacity, int max_per_host)
+{
+	this->capacity = capacity;
+	this->max_per_host = max_per_host;
+	queued = 0;
+	closed = false;
+}
+
+void HostQueue::push(const fetch_data &fd)
+{
+	unique_lock<mutex> lock(m_hosts);
+	cv_space.wait(lock, [this]{ return queued < capacity || closed; });
+	if (closed)
+	{
+		return;
+	}
+	string host = url_host(fd.source);
+	host_state &h = hosts[host];
+	h.pending.push_back(fd);
+	queued++;
+	schedule(host, h);
+}
+
+bool HostQueue::try_pop(fetch_data &fd)
+{
+	unique_lock<mutex> lock(m_hosts);
+	return take(fd);
+}
+
+void HostQueue::pop(fetch_data &fd)
+{
+	unique_lock<mutex> lock(m_hosts);
+	cv_ready.wait(lock, [this]{ return !ring.empty() || closed; });
+	take(fd);
+}
+
+bool HostQueue::pop_for(fetch_data &fd, int timeout_ms)
+{
+	unique_lock<mutex> lock(m_hosts);
+	cv_ready.wait_for(lock, chrono::milliseconds(timeout_ms), [this]{ return !ring.empty() || closed; });
+	return take(fd);
+}
+
+void HostQueue::done(const string &host)
+{
+	unique_lock<mutex> lock(m_hosts);
+	unordered_map<string, host_state>::iterator it = hosts.find(host);
+	if (it == hosts.end())
+	{
+		return;
+	}
+	host_state &h = it->second;
+	h.inflight--;
+	// forget hosts with nothing left to do
+	if (h.inflight <= 0 && h.pending.empty())
+	{
+		hosts.erase(it);
+		return;
+	}
+	schedule(host, h);
+}
+
+void HostQueue::close()
+{
+	unique_lock<mutex> lock(m_hosts);
+	closed = true;
+	for (auto &entry : hosts)
+	{
+		entry.second.pending.clear();
+		entry.second.in_ring = false;
+	}
+	ring.clear();
+	queued = 0;
+	cv_ready.notify_all();
+	cv_space.notify_all();
+}
+
+size_t HostQueue::size()
+{
+	unique_lock<mutex> lock(m_hosts);
+	return queued;
+}
+
+size_t HostQueue::ready()
+{
+	unique_lock<mutex> lock(m_hosts);
+	return ring.size();
+}
+
+bool HostQueue::take(fetch_data &fd)
+{
+	/* serves the host at the front of the ring, then sends it to the back */
+
+	if (ring.empty())
+	{
+		return false;
+	}
+	string host = ring.front();
+	ring.pop_front();
+	host_state &h = hosts[host];
+	h.in_ring = false;
+	fd = h.pending.front();
+	h.pending.pop_front();
+	h.inflight++;
+	queued--;
+	cv_space.notify_one();
+	schedule(host, h);
+	return true;
+}
+
+void HostQueue::schedule(const string &host, host_state &h)
+{
+	/* puts a host in the ring if it has work and room for another fetch */
+
+	if (h.in_ring || h.pending.empty())
+	{
+		return;
+	}
+	if (max_per_host > 0 && h.inflight >= max_per_host)
+	{
+		return;
+	}
+	h.in_ring = true;
+	ring.push_back(host);
+	cv_ready.notify_one();
+}
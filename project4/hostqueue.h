@@ -0,0 +1,69 @@
+// hostqueue.h
+
+#ifndef HOSTQUEUE_H
+#define HOSTQUEUE_H
+
+#include <string>
+#include <deque>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+
+#include "sitedata.h"
+
+using namespace std;
+
+// Fetch queue grouped by host.  pop hands out work round-robin across hosts
+// and never lets more than max_per_host fetches of one host be in flight, so
+// a domain with many urls cannot take every fetch thread.  Every fetch that
+// is popped must be given back with done() once it has finished.
+class HostQueue
+{
+public:
+	// capacity bounds the queued fetches over all hosts; max_per_host of 0
+	// means no per-host limit
+	HostQueue(size_t capacity, int max_per_host);
+
+	// waits while capacity fetches are queued
+	void push(const fetch_data &fd);
+	// next fetch from the next host with a free slot, false if none
+	bool try_pop(fetch_data &fd);
+	// waits for a fetch from a host with a free slot, or until closed
+	void pop(fetch_data &fd);
+	// waits at most timeout_ms, false if no fetch could start
+	bool pop_for(fetch_data &fd, int timeout_ms);
+	// a fetch popped for host has finished, freeing its slot
+	void done(const string &host);
+	// drops every queued fetch and wakes all waiters; later pushes are
+	// dropped too and pops find nothing
+	void close();
+
+	size_t size();
+	// hosts with a fetch that could start now
+	size_t ready();
+	bool empty() { return size() == 0; }
+
+private:
+	struct host_state
+	{
+		deque<fetch_data> pending;
+		int inflight = 0;
+		bool in_ring = false;
+	};
+
+	bool take(fetch_data &fd);
+	void schedule(const string &host, host_state &h);
+
+	size_t capacity;
+	int max_per_host;
+	mutex m_hosts;
+	condition_variable cv_ready;
+	condition_variable cv_space;
+	unordered_map<string, host_state> hosts;
+	// hosts that have pending fetches and a free slot, in serving order
+	deque<string> ring;
+	size_t queued;
+	bool closed;
+};
+
+#endif
@@ -0,0 +1,333 @@
+// htmltext.cpp
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#include "htmltext.h"
+
+using namespace std;
+
+// tags that do not separate words
+static const char *inline_tags[] = {"a", "abbr", "b", "bdi", "bdo", "cite", "code", "em", "font",
+	"i", "kbd", "mark", "q", "s", "small", "span", "strong", "sub", "sup", "time", "u", "var"};
+
+// named entities worth decoding; the rest are left as they are
+static const struct { const char *name; const char *text; } entities[] = {
+	{"amp", "&"}, {"lt", "<"}, {"gt", ">"}, {"quot", "\""}, {"apos", "'"}, {"nbsp", " "},
+	{"copy", "\xc2\xa9"}, {"reg", "\xc2\xae"}, {"ndash", "\xe2\x80\x93"}, {"mdash", "\xe2\x80\x94"},
+	{"lsquo", "\xe2\x80\x98"}, {"rsquo", "\xe2\x80\x99"}, {"ldquo", "\xe2\x80\x9c"},
+	{"rdquo", "\xe2\x80\x9d"}, {"hellip", "\xe2\x80\xa6"}};
+
+// longest entity name or number we look for
+static const size_t MAX_ENTITY = 12;
+
+static size_t find_either(const char *data, size_t i, size_t len, char a, char b)
+{
+	/* position of the first a or b at or after i, 16 bytes at a time */
+
+#ifdef __SSE2__
+	__m128i va = _mm_set1_epi8(a);
+	__m128i vb = _mm_set1_epi8(b);
+	while (i + 16 <= len)
+	{
+		__m128i v = _mm_loadu_si128((const __m128i *)(data + i));
+		int mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, va), _mm_cmpeq_epi8(v, vb)));
+		if (mask != 0)
+		{
+			return i + __builtin_ctz(mask);
+		}
+		i += 16;
+	}
+#endif
+	while (i < len && data[i] != a && data[i] != b)
+	{
+		i++;
+	}
+	return i;
+}
+
+static void append_utf8(unsigned long cp, string &out)
+{
+	if (cp < 0x80)
+	{
+		out += (char)cp;
+	}
+	else if (cp < 0x800)
+	{
+		out += (char)(0xc0 | (cp >> 6));
+		out += (char)(0x80 | (cp & 0x3f));
+	}
+	else if (cp < 0x10000)
+	{
+		out += (char)(0xe0 | (cp >> 12));
+		out += (char)(0x80 | ((cp >> 6) & 0x3f));
+		out += (char)(0x80 | (cp & 0x3f));
+	}
+	else
+	{
+		out += (char)(0xf0 | (cp >> 18));
+		out += (char)(0x80 | ((cp >> 12) & 0x3f));
+		out += (char)(0x80 | ((cp >> 6) & 0x3f));
+		out += (char)(0x80 | (cp & 0x3f));
+	}
+}
+
+HtmlText::HtmlText()
+{
+	reset();
+}
+
+void HtmlText::reset()
+{
+	state = TEXT;
+	name.clear();
+	closing = false;
+	quote = 0;
+	dashes = 0;
+	raw_end.clear();
+	raw_seen = 0;
+	entity.clear();
+}
+
+void HtmlText::feed(const char *data, size_t len, string &out)
+{
+	size_t i = 0;
+	while (i < len)
+	{
+		char c = data[i];
+		switch (state)
+		{
+		case TEXT:
+		{
+			// copy everything up to the next tag or entity at once
+			size_t next = find_either(data, i, len, '<', '&');
+			out.append(data + i, next - i);
+			i = next;
+			if (i < len)
+			{
+				state = data[i] == '<' ? OPEN : ENTITY;
+				entity.clear();
+				i++;
+			}
+			break;
+		}
+		case OPEN:
+			// only a letter, / ! or ? after < starts a tag
+			if (isalpha((unsigned char)c) || c == '!' || c == '?')
+			{
+				name.assign(1, tolower((unsigned char)c));
+				closing = false;
+				state = NAME;
+				i++;
+			}
+			else if (c == '/')
+			{
+				name.clear();
+				closing = true;
+				state = NAME;
+				i++;
+			}
+			else
+			{
+				out += '<';
+				state = TEXT;
+			}
+			break;
+		case NAME:
+			if (c == '>')
+			{
+				end_tag(out);
+			}
+			else if (isspace((unsigned char)c) || c == '/')
+			{
+				state = TAG;
+			}
+			else if (name.size() < 16)
+			{
+				name += tolower((unsigned char)c);
+				if (name.compare("!--") == 0)
+				{
+					state = COMMENT;
+					dashes = 0;
+				}
+			}
+			i++;
+			break;
+		case TAG:
+			if (c == '>')
+			{
+				end_tag(out);
+			}
+			else if (c == '"' || c == '\'')
+			{
+				quote = c;
+				state = QUOTE;
+			}
+			i++;
+			break;
+		case QUOTE:
+		{
+			// a > inside an attribute value does not end the tag
+			const char *end = (const char *)memchr(data + i, quote, len - i);
+			if (end == NULL)
+			{
+				i = len;
+				break;
+			}
+			i = end - data + 1;
+			state = TAG;
+			break;
+		}
+		case COMMENT:
+		{
+			size_t next = find_either(data, i, len, '-', '>');
+			// anything else between the dashes and > resets them
+			if (next > i)
+			{
+				dashes = 0;
+			}
+			i = next;
+			if (i == len)
+			{
+				break;
+			}
+			if (data[i] == '-')
+			{
+				dashes++;
+			}
+			else if (dashes >= 2)
+			{
+				out += ' ';
+				state = TEXT;
+			}
+			else
+			{
+				dashes = 0;
+			}
+			i++;
+			break;
+		}
+		case RAW:
+			// script and style end at their closing tag, whatever else is inside
+			if (raw_seen == 0)
+			{
+				const char *lt = (const char *)memchr(data + i, '<', len - i);
+				if (lt == NULL)
+				{
+					i = len;
+					break;
+				}
+				i = lt - data + 1;
+				raw_seen = 1;
+			}
+			else if (tolower((unsigned char)c) == raw_end[raw_seen])
+			{
+				raw_seen++;
+				i++;
+				if (raw_seen == raw_end.size())
+				{
+					name = raw_end.substr(2);
+					closing = true;
+					raw_seen = 0;
+					state = TAG;
+				}
+			}
+			else
+			{
+				// look at c again, it may be the next <
+				raw_seen = 0;
+			}
+			break;
+		case ENTITY:
+			if (c == ';')
+			{
+				end_entity(out);
+				state = TEXT;
+				i++;
+			}
+			else if ((isalnum((unsigned char)c) || c == '#') && entity.size() < MAX_ENTITY)
+			{
+				entity += c;
+				i++;
+			}
+			else
+			{
+				// not an entity after all
+				out += '&';
+				out += entity;
+				state = TEXT;
+			}
+			break;
+		}
+	}
+}
+
+void HtmlText::finish(string &out)
+{
+	if (state == ENTITY)
+	{
+		out += '&';
+		out += entity;
+	}
+	else if (state == OPEN)
+	{
+		out += '<';
+	}
+	reset();
+}
+
+void HtmlText::end_tag(string &out)
+{
+	/* called at the > of a tag */
+
+	if (!closing && (name.compare("script") == 0 || name.compare("style") == 0))
+	{
+		raw_end = "</" + name;
+		raw_seen = 0;
+		state = RAW;
+		return;
+	}
+	state = TEXT;
+	for (const char *tag : inline_tags)
+	{
+		if (name.compare(tag) == 0)
+		{
+			return;
+		}
+	}
+	out += ' ';
+}
+
+void HtmlText::end_entity(string &out)
+{
+	/* called at the ; of an entity */
+
+	if (entity.size() > 1 && entity[0] == '#')
+	{
+		bool hex = entity[1] == 'x' || entity[1] == 'X';
+		const char *digits = entity.c_str() + (hex ? 2 : 1);
+		char *end;
+		unsigned long cp = strtoul(digits, &end, hex ? 16 : 10);
+		// skip nul, surrogates and numbers past unicode
+		if (*digits != '\0' && *end == '\0' && cp > 0 && cp <= 0x10ffff && (cp < 0xd800 || cp > 0xdfff))
+		{
+			append_utf8(cp, out);
+			return;
+		}
+	}
+	for (const auto &e : entities)
+	{
+		if (entity.compare(e.name) == 0)
+		{
+			out += e.text;
+			return;
+		}
+	}
+	out += '&';
+	out += entity;
+	out += ';';
+}
@@ -0,0 +1,46 @@
+// htmltext.h
+
+#ifndef HTMLTEXT_H
+#define HTMLTEXT_H
+
+#include <string>
+
+using namespace std;
+
+// Streaming extraction of the visible text of an html page, so terms are not
+// counted in markup.  Tags and their attributes, comments and the contents of
+// <script> and <style> are dropped, entities are decoded to utf-8, and tags
+// other than inline ones like <b> or <a> become a space so words on either
+// side stay apart.  Chunks may split anything anywhere.
+class HtmlText
+{
+public:
+	HtmlText();
+
+	// start a new page
+	void reset();
+	// appends the text of the next chunk of html to out
+	void feed(const char *data, size_t len, string &out);
+	// appends whatever the last chunk left unfinished
+	void finish(string &out);
+
+private:
+	enum { TEXT, OPEN, NAME, TAG, QUOTE, COMMENT, RAW, ENTITY };
+
+	void end_tag(string &out);
+	void end_entity(string &out);
+
+	int state;
+	// lower case tag name, cut short after a few bytes
+	string name;
+	bool closing;
+	char quote;
+	// '-' bytes in a row inside a comment
+	int dashes;
+	// "</script" or "</style" while inside one, and how much of it was seen
+	string raw_end;
+	size_t raw_seen;
+	string entity;
+};
+
+#endif
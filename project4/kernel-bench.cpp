@@ -0,0 +1,379 @@
+/*
+	kernel-bench.cpp
+	J. Patrick Lacher	and		James Marvin
+	jlacher1@nd.edu				jmarvin1@nd.edu
+	Operating Systems CSE 30341
+	Measures the term counting kernels and checks them against the original loop
+	and the pattern term DFA against fixed expectations
+*/
+
+// include c++ modules
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <algorithm>
+
+// include c modules
+#include <stdlib.h>
+
+// include custom c++ function files
+#include "parsesite.h"
+#include "matcher.h"
+#include "lazydfa.h"
+
+// namespace declaration
+using namespace std;
+
+// benchmark settings, given on the command line as KEY=value
+struct bench_config
+{
+	vector<int> sizes = {4096, 65536, 1048576}; // body bytes
+	vector<int> num_terms = {1, 8, 64}; // terms counted per body
+	vector<int> term_lengths = {4, 16}; // bytes per term
+	vector<int> densities = {0, 2, 32}; // term hits per KB of body
+	int min_ms = 100; // each measurement repeats for at least this long
+};
+
+bench_config bcfg;
+
+int original_count(string site, string search)
+{
+	/* count_occurrences as first written, the reference for every kernel */
+
+	int occurrences = 0;
+	string::size_type pos = 0;
+	while ((pos = site.find(search, pos)) != string::npos) {
+		occurrences++;
+		pos += 1;
+	}
+
+	return occurrences;
+}
+
+vector<int> parse_list(const string &value)
+{
+	vector<int> list;
+	istringstream fields(value);
+	string field;
+	while (getline(fields, field, ','))
+	{
+		list.push_back(atoi(field.c_str()));
+	}
+	return list;
+}
+
+bool at_least(const vector<int> &list, int minimum)
+{
+	for (int value : list)
+	{
+		if (value < minimum)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+bool parse_args(int argc, char * argv[])
+{
+	/* reads KEY=value arguments into bcfg */
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		string::size_type eq = arg.find('=');
+		if (eq == string::npos)
+		{
+			return false;
+		}
+		string key = arg.substr(0, eq);
+		string value = arg.substr(eq + 1);
+		if (key.compare("SIZES")==0)
+		{
+			bcfg.sizes = parse_list(value);
+		}
+		else if (key.compare("TERMS")==0)
+		{
+			bcfg.num_terms = parse_list(value);
+		}
+		else if (key.compare("TERM_LENGTHS")==0)
+		{
+			bcfg.term_lengths = parse_list(value);
+		}
+		else if (key.compare("DENSITIES")==0)
+		{
+			bcfg.densities = parse_list(value);
+		}
+		else if (key.compare("MIN_MS")==0)
+		{
+			bcfg.min_ms = atoi(value.c_str());
+		}
+		else
+		{
+			return false;
+		}
+	}
+	// enforce sensible input; every body needs at least one term to insert
+	return bcfg.min_ms >= 0 && at_least(bcfg.sizes, 0) && at_least(bcfg.num_terms, 1)
+		&& at_least(bcfg.term_lengths, 1) && at_least(bcfg.densities, 0);
+}
+
+vector<string> make_terms(mt19937 &rng, int count, int length)
+{
+	/* lowercase words; the first letters repeat so prefixes are shared */
+
+	vector<string> terms;
+	for (int t = 0; t < count; t++)
+	{
+		string term;
+		for (int i = 0; i < length; i++)
+		{
+			term += (char)('a' + (i < 2 ? rng() % 4 : rng() % 26));
+		}
+		terms.push_back(term);
+	}
+	return terms;
+}
+
+string make_body(mt19937 &rng, int size, const vector<string> &terms, int density)
+{
+	/* html-like filler with terms inserted density times per KB */
+
+	static const char *filler[] = {"<div class=\"story\">", "</div>", "<p>", "</p>", "the ", "news ",
+		"<a href=\"/world/2017/index.html\">", "</a>", "<span>", "</span>", "and ", "report ",
+		"<img src=\"/img/a.png\" alt=\"\">", "\n", "    ", "weather ", "&nbsp;", "<br>"};
+	const int num_filler = sizeof(filler) / sizeof(filler[0]);
+	double term_chance = density * 8.0 / 1024.0;
+	uniform_real_distribution<double> coin(0.0, 1.0);
+	string body;
+	while ((int)body.size() < size)
+	{
+		if (coin(rng) < term_chance)
+		{
+			body += terms[rng() % terms.size()];
+		}
+		else
+		{
+			body += filler[rng() % num_filler];
+		}
+	}
+	body.resize(size);
+	return body;
+}
+
+template <typename F>
+double measure(size_t bytes, F count_all)
+{
+	/* GB/s of count_all over bytes, repeated for at least min_ms */
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	long reps = 0;
+	double elapsed;
+	do
+	{
+		count_all();
+		reps++;
+		elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+	while (elapsed * 1000 < bcfg.min_ms);
+	return (double)bytes * reps / elapsed / 1e9;
+}
+
+bool same(const vector<int> &want, const vector<int> &got, const string &kernel)
+{
+	if (want == got)
+	{
+		return true;
+	}
+	cerr << "Error: " << kernel << " counts differ from the original loop" << endl;
+	return false;
+}
+
+vector<int> dfa_count(const LazyDFA &dfa, size_t num_terms, const string &body, size_t chunk)
+{
+	/* counts with the lazy DFA, fed chunk bytes at a time */
+
+	vector<int> counts(num_terms, 0);
+	dfa_stream ds;
+	dfa.start(ds, counts);
+	for (size_t pos = 0; pos < body.size(); pos += chunk)
+	{
+		dfa.feed(ds, body.data() + pos, min(chunk, body.size() - pos), counts);
+	}
+	dfa.finish(ds, counts);
+	return counts;
+}
+
+vector<int> stream_count(const Matcher &matcher, const string &body, size_t chunk)
+{
+	/* counts as a download would, chunk bytes at a time */
+
+	match_stream ms;
+	matcher.start(ms);
+	for (size_t pos = 0; pos < body.size(); pos += chunk)
+	{
+		matcher.feed(ms, body.data() + pos, min(chunk, body.size() - pos));
+	}
+	return matcher.finish(ms);
+}
+
+bool check_dfa(const vector<string> &terms, const string &body, const vector<int> &want)
+{
+	/* literal terms forced through the lazy DFA, whole and a byte at a time */
+
+	LazyDFA dfa;
+	dfa.compile(terms);
+	bool ok = same(want, dfa_count(dfa, terms.size(), body, max(body.size(), (size_t)1)), "lazy DFA");
+	return same(want, dfa_count(dfa, terms.size(), body, 1), "byte by byte lazy DFA") && ok;
+}
+
+bool check_edge_cases()
+{
+	/* overlapping, repeated and boundary cases the random corpus rarely hits */
+
+	vector<string> bodies = {"", "a", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa",
+		"abababababababababababababababababababababababababababababababababab",
+		string(100, 'x') + "needle" + string(37, 'y') + "needle", "needle"};
+	vector<string> terms = {"a", "aa", "aaa", "ab", "aba", "bab", "needle", "x", "yn", "eedle", "", "zzz"};
+	Matcher automaton, small;
+	automaton.compile(terms, 0);
+	bool ok = true;
+	for (const string &body : bodies)
+	{
+		vector<int> want;
+		vector<int> kernel;
+		for (const string &term : terms)
+		{
+			want.push_back(original_count(body, term));
+			kernel.push_back(count_occurrences(body, term));
+		}
+		ok = same(want, kernel, "count_occurrences") && ok;
+		ok = same(want, automaton.count(body), "automaton") && ok;
+		ok = same(want, stream_count(automaton, body, 1), "byte by byte automaton") && ok;
+		ok = check_dfa(terms, body, want) && ok;
+		for (size_t t = 0; t < terms.size(); t++)
+		{
+			small.compile(vector<string>(1, terms[t]), 1);
+			ok = same(vector<int>(1, want[t]), small.count(body), "single term matcher") && ok;
+		}
+	}
+	return ok;
+}
+
+bool check_patterns()
+{
+	/* pattern terms against counts worked out by hand */
+
+	struct pattern_case
+	{
+		string term;
+		string body;
+		int want;
+	};
+	vector<pattern_case> cases = {
+		{"/needle/i", "Needle NEEDLE needle nEeDlE needl", 4},
+		// ignore case folds ASCII letters only
+		{"/\xc3\xa9/i", "\xc3\xa9 \xc3\x89", 1},
+		{"/cat/w", "cat concat cat_ cats (cat) cat", 3},
+		{"/cat/iw", "Cat CAT scatter", 2},
+		{"/20[0-9]{2}/r", "1999 2017 2020 20x1 12017", 3},
+		{"/a+/r", "aaa b aa", 5},
+		{"/ab|cd/r", "abcdab", 3},
+		{"/colou?r/r", "color colour colouur", 2},
+		{"/\\d+/rw", "a1 22 333 x4y", 2},
+		{"/a.c/r", "abc a\nc", 1},
+		{"/[^a-z]x/ir", "Ax 1x", 1},
+		{"/(ab){2,3}/r", "abababab", 3},
+		// too many NFA states: searched for as the literal line
+		{"/((a{1000}){1000}){1000}/r", "/((a{1000}){1000}){1000}/r " + string(2000, 'a'), 1},
+		{"/a(b/r", "/a(b/r", 1},
+	};
+	bool ok = true;
+	for (const pattern_case &pc : cases)
+	{
+		Matcher matcher;
+		matcher.compile(vector<string>(1, pc.term), 0);
+		vector<int> want(1, pc.want);
+		if (matcher.count(pc.body) != want || stream_count(matcher, pc.body, 1) != want)
+		{
+			cerr << "Error: " << pc.term << " counts " << matcher.count(pc.body)[0] << " in \""
+				<< pc.body.substr(0, 40) << "\", expected " << pc.want << endl;
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+int main( int argc, char * argv[] )
+{
+	/* main program execution */
+
+	if (!parse_args(argc, argv))
+	{
+		cerr << "Usage:" << endl;
+		cerr << "\t./kernel-bench [SIZES=4096,65536,1048576] [TERMS=1,8,64] [TERM_LENGTHS=4,16] [DENSITIES=0,2,32] [MIN_MS=100]" << endl;
+		return 1;
+	}
+	if (!check_edge_cases() || !check_patterns())
+	{
+		return 1;
+	}
+	bool ok = true;
+	mt19937 rng(2017);
+	cout << "    bytes terms len hits/KB  original GB/s  kernel GB/s  automaton GB/s" << endl;
+	for (int size : bcfg.sizes)
+	{
+		for (int num_terms : bcfg.num_terms)
+		{
+			for (int length : bcfg.term_lengths)
+			{
+				for (int density : bcfg.densities)
+				{
+					vector<string> terms = make_terms(rng, num_terms, length);
+					string body = make_body(rng, size, terms, density);
+					Matcher automaton;
+					automaton.compile(terms, 0);
+					// every kernel must agree before it is timed
+					vector<int> want, kernel;
+					for (const string &term : terms)
+					{
+						want.push_back(original_count(body, term));
+						kernel.push_back(count_occurrences(body, term));
+					}
+					ok = same(want, kernel, "count_occurrences") && ok;
+					ok = same(want, automaton.count(body), "automaton") && ok;
+					ok = check_dfa(terms, body, want) && ok;
+					volatile long sink = 0;
+					double original = measure(body.size(), [&]{
+						for (const string &term : terms)
+						{
+							sink += original_count(body, term);
+						}
+					});
+					double vector_kernel = measure(body.size(), [&]{
+						for (const string &term : terms)
+						{
+							sink += count_occurrences(body, term);
+						}
+					});
+					double automaton_scan = measure(body.size(), [&]{
+						sink += automaton.count(body)[0];
+					});
+					cout << setw(9) << size << setw(6) << num_terms << setw(4) << length
+						<< setw(8) << density << fixed << setprecision(3)
+						<< setw(15) << original << setw(13) << vector_kernel
+						<< setw(16) << automaton_scan << endl;
+				}
+			}
+		}
+	}
+	if (!ok)
+	{
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,916 @@
+// lazydfa.cpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <atomic>
+#include <algorithm>
+#include <bitset>
+#include <stdlib.h>
+#include <string.h>
+#include "lazydfa.h"
+
+using namespace std;
+
+// give every compiled DFA and every cache generation its own number, so a
+// thread's cache can tell it no longer holds states of this DFA
+static atomic<uint64_t> next_id(1);
+
+// a thread's cache is cleared once it holds this many states, or its table
+// and state keys this many bytes
+static const size_t MAX_STATES = 10000;
+static const size_t MAX_TABLE_BYTES = 32 << 20;
+// a cache that filled up in fewer bytes than this per state was building a
+// state for most bytes; the next SIMULATE_BYTES are run on the NFA directly
+static const size_t MIN_BYTES_PER_STATE = 10;
+static const size_t SIMULATE_BYTES = 4 << 20;
+
+// most repetitions a {m,n} may ask for
+static const int MAX_REPEAT = 1000;
+// most NFA states all terms together may compile to; nested repeats
+// multiply, so each {m,n} being in range is not enough
+static const size_t MAX_NFA_STATES = 100000;
+
+static bool is_word(unsigned char c)
+{
+	/* bytes of utf-8 sequences count as letters */
+	return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')
+		|| c == '_' || c >= 0x80;
+}
+
+static bitset<256> fold_case(bitset<256> set)
+{
+	/* ASCII letters only; the bytes of other utf-8 letters match as they are */
+	for (int c = 'a'; c <= 'z'; c++)
+	{
+		if (set[c] || set[c - 'a' + 'A'])
+		{
+			set.set(c);
+			set.set(c - 'a' + 'A');
+		}
+	}
+	return set;
+}
+
+term_spec parse_term(const string &line)
+{
+	term_spec spec;
+	spec.pattern = line;
+	string::size_type close = line.rfind('/');
+	if (line.size() < 3 || line[0] != '/' || close == 0 || close == line.size() - 1)
+	{
+		return spec;
+	}
+	term_spec pattern;
+	for (char flag : line.substr(close + 1))
+	{
+		if (flag == 'i')
+		{
+			pattern.icase = true;
+		}
+		else if (flag == 'w')
+		{
+			pattern.word = true;
+		}
+		else if (flag == 'r')
+		{
+			pattern.regex = true;
+		}
+		else
+		{
+			// not a modifier, so the line is a literal
+			return spec;
+		}
+	}
+	pattern.pattern = line.substr(1, close - 1);
+	return pattern;
+}
+
+// built states of one DFA, private to one thread
+class LazyDFA::cache
+{
+public:
+	uint64_t owner = 0;
+	uint64_t epoch = 0;
+	int K = 1;
+	// next[state * K + class], -1 until the transition is first taken
+	vector<int32_t> next;
+	// terms counted on arriving in state s are
+	// out_terms[out_start[s] .. out_start[s+1])
+	vector<int32_t> out_start;
+	vector<int32_t> out_terms;
+	vector<vector<int32_t> > keys;
+	map<vector<int32_t>, int32_t> ids;
+	// bytes held by keys and ids
+	size_t key_bytes = 0;
+	// bytes scanned since the last reset, and bytes still to simulate
+	size_t scanned = 0;
+	size_t simulate = 0;
+
+	// scratch for step: NFA state s was visited if mark[s] == stamp
+	vector<uint32_t> mark;
+	uint32_t stamp = 0;
+	vector<int32_t> stack;
+	vector<int32_t> target;
+
+	void reset(uint64_t dfa, int classes, int32_t num_nfa)
+	{
+		if (owner != dfa)
+		{
+			mark.assign(num_nfa, 0);
+			stamp = 0;
+			simulate = 0;
+		}
+		owner = dfa;
+		epoch = next_id.fetch_add(1);
+		K = classes;
+		next.clear();
+		out_start.assign(1, 0);
+		out_terms.clear();
+		keys.clear();
+		ids.clear();
+		key_bytes = 0;
+		scanned = 0;
+	}
+
+	bool full() const
+	{
+		return keys.size() >= MAX_STATES || next.size() * sizeof(int32_t) + key_bytes >= MAX_TABLE_BYTES;
+	}
+
+	bool thrashing() const
+	{
+		return scanned < keys.size() * MIN_BYTES_PER_STATE;
+	}
+
+	void next_stamp()
+	{
+		if (++stamp == 0)
+		{
+			fill(mark.begin(), mark.end(), 0);
+			stamp = 1;
+		}
+	}
+
+	int32_t intern(const vector<int32_t> &key, int32_t num_nfa, int32_t num_terms)
+	{
+		/* state number of key, adding the state if it is new */
+
+		map<vector<int32_t>, int32_t>::iterator it = ids.find(key);
+		if (it != ids.end())
+		{
+			return it->second;
+		}
+		int32_t s = keys.size();
+		keys.push_back(key);
+		ids[key] = s;
+		// the key is held twice, plus the map node
+		key_bytes += 2 * (sizeof(key) + key.size() * sizeof(int32_t)) + 4 * sizeof(void *);
+		next.resize(next.size() + K, -1);
+		for (size_t i = 0; i < key.size(); i++)
+		{
+			if (key[i] >= num_nfa + num_terms)
+			{
+				out_terms.push_back(key[i] - num_nfa - num_terms);
+			}
+		}
+		out_start.push_back(out_terms.size());
+		return s;
+	}
+};
+
+LazyDFA::LazyDFA()
+{
+	id = next_id.fetch_add(1);
+	num_nfa = 0;
+	num_terms = 0;
+	memset(byte_class, 0, sizeof(byte_class));
+	num_classes = 1;
+	class_byte.assign(1, 0);
+}
+
+vector<string> LazyDFA::compile(const vector<string> &terms)
+{
+	/* one NFA fragment per term, each ending in a MATCH state for its term */
+
+	id = next_id.fetch_add(1);
+	nfa.clear();
+	sets.clear();
+	roots.clear();
+	whole_word.clear();
+	vector<string> errors;
+	for (size_t t = 0; t < terms.size(); t++)
+	{
+		term_spec spec = parse_term(terms[t]);
+		node tree;
+		string error;
+		bool parsed = !spec.regex || parse_regex(spec.pattern, spec.icase, tree, error);
+		if (parsed && spec.regex && nfa.size() + nfa_size(tree) > MAX_NFA_STATES)
+		{
+			error = "pattern is too large";
+			parsed = false;
+		}
+		if (!parsed)
+		{
+			errors.push_back(terms[t] + ": " + error);
+			spec = term_spec();
+			spec.pattern = terms[t];
+			// drop what was parsed, the literal is built from scratch
+			tree = node();
+		}
+		if (!spec.regex)
+		{
+			tree.type = node::CAT;
+			for (unsigned char c : spec.pattern)
+			{
+				node byte;
+				byte.type = node::SET;
+				bitset<256> set;
+				set.set(c);
+				byte.set = add_set(set, spec.icase);
+				tree.kids.push_back(byte);
+			}
+		}
+		fragment f = build(tree);
+		int32_t match = add_state(MATCH, t, -1, -1);
+		nfa[f.end].out = match;
+		roots.push_back(f.start);
+		whole_word.push_back(spec.word);
+	}
+	num_nfa = nfa.size();
+	num_terms = terms.size();
+	make_classes();
+	// the states every step starts new matches from; the start of a body
+	// counts as following a non-letter, so whole word terms may start there
+	cache c;
+	c.reset(id, num_classes, num_nfa);
+	for (int after_word = 0; after_word < 2; after_word++)
+	{
+		c.next_stamp();
+		vector<int32_t> ids;
+		for (int32_t t = 0; t < num_terms; t++)
+		{
+			if (!after_word || !whole_word[t])
+			{
+				closure(c, roots[t], ids);
+			}
+		}
+		if (!after_word)
+		{
+			sort(ids.begin(), ids.end());
+			start_key = ids;
+		}
+		restart[after_word].clear();
+		for (int32_t s = 0; s < num_nfa; s++)
+		{
+			if (c.mark[s] == c.stamp && (nfa[s].type == BYTES || nfa[s].type == MATCH))
+			{
+				restart[after_word].push_back(s);
+			}
+		}
+	}
+	return errors;
+}
+
+bool LazyDFA::parse_regex(const string &re, bool icase, node &tree, string &error)
+{
+	size_t pos = 0;
+	if (!parse_alt(re, pos, icase, tree, error))
+	{
+		return false;
+	}
+	if (pos != re.size())
+	{
+		error = "unmatched )";
+		return false;
+	}
+	return true;
+}
+
+bool LazyDFA::parse_alt(const string &re, size_t &pos, bool icase, node &tree, string &error)
+{
+	/* alternatives separated by |, each a sequence of repeated atoms */
+
+	node alt;
+	alt.type = node::ALT;
+	while (1)
+	{
+		node cat;
+		cat.type = node::CAT;
+		while (pos < re.size() && re[pos] != '|' && re[pos] != ')')
+		{
+			node atom;
+			if (!parse_atom(re, pos, icase, atom, error))
+			{
+				return false;
+			}
+			while (pos < re.size() && (re[pos] == '*' || re[pos] == '+' || re[pos] == '?' || re[pos] == '{'))
+			{
+				node repeat;
+				repeat.type = node::REPEAT;
+				char q = re[pos++];
+				if (q == '*' || q == '+')
+				{
+					repeat.min = (q == '+');
+					repeat.max = -1;
+				}
+				else if (q == '?')
+				{
+					repeat.min = 0;
+					repeat.max = 1;
+				}
+				else
+				{
+					// {m}, {m,} or {m,n}
+					size_t close = re.find('}', pos);
+					string inside = re.substr(pos, close == string::npos ? 0 : close - pos);
+					size_t comma = inside.find(',');
+					string low = inside.substr(0, comma);
+					string high = comma == string::npos ? low : inside.substr(comma + 1);
+					if (close == string::npos || low.empty()
+						|| low.find_first_not_of("0123456789") != string::npos
+						|| high.find_first_not_of("0123456789") != string::npos)
+					{
+						error = "bad {} repeat";
+						return false;
+					}
+					repeat.min = atoi(low.c_str());
+					repeat.max = high.empty() ? -1 : atoi(high.c_str());
+					pos = close + 1;
+					if (repeat.min > MAX_REPEAT || repeat.max > MAX_REPEAT
+						|| (repeat.max >= 0 && repeat.max < repeat.min))
+					{
+						error = "bad {} repeat";
+						return false;
+					}
+				}
+				repeat.kids.push_back(atom);
+				atom = repeat;
+			}
+			cat.kids.push_back(atom);
+		}
+		alt.kids.push_back(cat);
+		if (pos < re.size() && re[pos] == '|')
+		{
+			pos++;
+			continue;
+		}
+		break;
+	}
+	if (alt.kids.size() == 1)
+	{
+		tree = alt.kids[0];
+	}
+	else
+	{
+		tree = alt;
+	}
+	return true;
+}
+
+static bitset<256> escape_set(char c)
+{
+	/* \d \w \s and friends, or the escaped byte itself */
+
+	bitset<256> set;
+	switch (c)
+	{
+	case 'd': case 'D':
+		for (int b = '0'; b <= '9'; b++)
+		{
+			set.set(b);
+		}
+		break;
+	case 'w': case 'W':
+		for (int b = 0; b < 128; b++)
+		{
+			if (is_word(b))
+			{
+				set.set(b);
+			}
+		}
+		break;
+	case 's': case 'S':
+		for (char b : string(" \t\n\r\f\v"))
+		{
+			set.set((unsigned char)b);
+		}
+		break;
+	case 'n':
+		set.set('\n');
+		return set;
+	case 't':
+		set.set('\t');
+		return set;
+	case 'r':
+		set.set('\r');
+		return set;
+	case 'f':
+		set.set('\f');
+		return set;
+	case 'v':
+		set.set('\v');
+		return set;
+	default:
+		set.set((unsigned char)c);
+		return set;
+	}
+	// upper case classes are the complement
+	if (c == 'D' || c == 'W' || c == 'S')
+	{
+		set.flip();
+	}
+	return set;
+}
+
+bool LazyDFA::parse_atom(const string &re, size_t &pos, bool icase, node &atom, string &error)
+{
+	/* a group, a [] class, ., an escape or a single byte */
+
+	char c = re[pos++];
+	bitset<256> set;
+	switch (c)
+	{
+	case '(':
+		if (re.compare(pos, 2, "?:") == 0)
+		{
+			pos += 2;
+		}
+		if (!parse_alt(re, pos, icase, atom, error))
+		{
+			return false;
+		}
+		if (pos >= re.size() || re[pos] != ')')
+		{
+			error = "missing )";
+			return false;
+		}
+		pos++;
+		return true;
+	case '[':
+	{
+		bool negate = pos < re.size() && re[pos] == '^';
+		if (negate)
+		{
+			pos++;
+		}
+		bool first = true;
+		while (pos < re.size() && (re[pos] != ']' || first))
+		{
+			first = false;
+			unsigned char low = re[pos++];
+			if (low == '\\' && pos < re.size())
+			{
+				bitset<256> escaped = escape_set(re[pos++]);
+				if (escaped.count() != 1)
+				{
+					set |= escaped;
+					continue;
+				}
+				low = escaped._Find_first();
+			}
+			unsigned char high = low;
+			if (pos + 1 < re.size() && re[pos] == '-' && re[pos + 1] != ']')
+			{
+				high = re[pos + 1];
+				pos += 2;
+				if (high == '\\' && pos < re.size())
+				{
+					high = escape_set(re[pos++])._Find_first();
+				}
+				if (high < low)
+				{
+					error = "bad range in []";
+					return false;
+				}
+			}
+			for (int b = low; b <= high; b++)
+			{
+				set.set(b);
+			}
+		}
+		if (pos >= re.size())
+		{
+			error = "missing ]";
+			return false;
+		}
+		pos++;
+		if (negate)
+		{
+			// fold first so case folding can not add excluded bytes back
+			atom.type = node::SET;
+			atom.set = add_set(~(icase ? fold_case(set) : set), false);
+			return true;
+		}
+		break;
+	}
+	case '.':
+		set.set();
+		set.reset('\n');
+		break;
+	case '\\':
+		if (pos >= re.size())
+		{
+			error = "trailing \\";
+			return false;
+		}
+		if (re[pos] == 'b' || re[pos] == 'B')
+		{
+			error = "\\b is not supported, use the w flag";
+			return false;
+		}
+		set = escape_set(re[pos++]);
+		break;
+	case '*': case '+': case '?': case '{':
+		error = "nothing to repeat";
+		return false;
+	case '^': case '$':
+		error = "anchors are not supported";
+		return false;
+	default:
+		set.set((unsigned char)c);
+		break;
+	}
+	atom.type = node::SET;
+	atom.set = add_set(set, icase);
+	return true;
+}
+
+int32_t LazyDFA::add_set(bitset<256> set, bool icase)
+{
+	/* index of set, folded to both cases for ignore case terms */
+
+	if (icase)
+	{
+		set = fold_case(set);
+	}
+	for (size_t i = 0; i < sets.size(); i++)
+	{
+		if (sets[i] == set)
+		{
+			return i;
+		}
+	}
+	sets.push_back(set);
+	return sets.size() - 1;
+}
+
+int32_t LazyDFA::add_state(int type, int32_t arg, int32_t out, int32_t out2)
+{
+	nfa_state s;
+	s.type = type;
+	s.arg = arg;
+	s.out = out;
+	s.out2 = out2;
+	nfa.push_back(s);
+	return nfa.size() - 1;
+}
+
+size_t LazyDFA::nfa_size(const node &tree)
+{
+	/* states build() would add for tree, stopping once past the limit */
+
+	size_t kids = 0;
+	for (const node &kid : tree.kids)
+	{
+		kids = min(kids + nfa_size(kid), MAX_NFA_STATES + 1);
+	}
+	size_t size = 0;
+	switch (tree.type)
+	{
+	case node::SET:
+		size = 2;
+		break;
+	case node::CAT:
+		size = 1 + kids;
+		break;
+	case node::ALT:
+		size = 1 + kids + tree.kids.size() - 1;
+		break;
+	case node::REPEAT:
+		// the required copies, then a loop or the optional copies
+		size = 2 + tree.min * kids;
+		size += tree.max < 0 ? kids + 1 : (tree.max - tree.min) * (kids + 1);
+		break;
+	}
+	return min(size, MAX_NFA_STATES + 1);
+}
+
+LazyDFA::fragment LazyDFA::build(const node &tree)
+{
+	/* Thompson construction; every fragment ends in an EPSILON state whose
+	 out is filled in by the caller.  nfa grows, so only indices are kept */
+
+	fragment f = {-1, -1};
+	switch (tree.type)
+	{
+	case node::SET:
+		f.end = add_state(EPSILON, -1, -1, -1);
+		f.start = add_state(BYTES, tree.set, f.end, -1);
+		return f;
+	case node::CAT:
+		f.start = f.end = add_state(EPSILON, -1, -1, -1);
+		for (const node &kid : tree.kids)
+		{
+			fragment g = build(kid);
+			nfa[f.end].out = g.start;
+			f.end = g.end;
+		}
+		return f;
+	case node::ALT:
+	{
+		f.end = add_state(EPSILON, -1, -1, -1);
+		vector<int32_t> starts;
+		for (const node &kid : tree.kids)
+		{
+			fragment g = build(kid);
+			nfa[g.end].out = f.end;
+			starts.push_back(g.start);
+		}
+		f.start = starts.back();
+		for (int i = (int)starts.size() - 2; i >= 0; i--)
+		{
+			f.start = add_state(SPLIT, -1, starts[i], f.start);
+		}
+		return f;
+	}
+	case node::REPEAT:
+	{
+		f.start = f.end = add_state(EPSILON, -1, -1, -1);
+		// the required copies
+		for (int i = 0; i < tree.min; i++)
+		{
+			fragment g = build(tree.kids[0]);
+			nfa[f.end].out = g.start;
+			f.end = g.end;
+		}
+		int32_t exit = add_state(EPSILON, -1, -1, -1);
+		if (tree.max < 0)
+		{
+			// a loop that may run any number of times more
+			fragment g = build(tree.kids[0]);
+			int32_t split = add_state(SPLIT, -1, g.start, exit);
+			nfa[g.end].out = split;
+			nfa[f.end].out = split;
+		}
+		else
+		{
+			// each optional copy may leave straight for the exit
+			for (int i = tree.min; i < tree.max; i++)
+			{
+				fragment g = build(tree.kids[0]);
+				int32_t split = add_state(SPLIT, -1, g.start, exit);
+				nfa[f.end].out = split;
+				f.end = g.end;
+			}
+			nfa[f.end].out = exit;
+		}
+		f.end = exit;
+		return f;
+	}
+	}
+	return f;
+}
+
+void LazyDFA::make_classes()
+{
+	/* bytes that every set, and the letter test, treat alike share a class */
+
+	map<string, int> signatures;
+	class_byte.clear();
+	for (int c = 0; c < 256; c++)
+	{
+		string signature(sets.size() + 1, '0');
+		for (size_t i = 0; i < sets.size(); i++)
+		{
+			signature[i] = sets[i][c] ? '1' : '0';
+		}
+		signature[sets.size()] = is_word(c) ? '1' : '0';
+		map<string, int>::iterator it = signatures.find(signature);
+		if (it == signatures.end())
+		{
+			it = signatures.insert(make_pair(signature, (int)class_byte.size())).first;
+			class_byte.push_back(c);
+		}
+		byte_class[c] = it->second;
+	}
+	num_classes = class_byte.size();
+}
+
+LazyDFA::cache &LazyDFA::thread_cache() const
+{
+	static thread_local cache c;
+	if (c.owner != id)
+	{
+		c.reset(id, num_classes, num_nfa);
+	}
+	return c;
+}
+
+void LazyDFA::closure(cache &c, int32_t root, vector<int32_t> &ids) const
+{
+	/* states reachable from root without reading a byte; BYTES states go into
+	 ids as they are, matches as pending (whole word) or counted markers.
+	 States marked with the current stamp were already visited */
+
+	vector<int32_t> &stack = c.stack;
+	stack.assign(1, root);
+	while (!stack.empty())
+	{
+		int32_t s = stack.back();
+		stack.pop_back();
+		if (s < 0 || c.mark[s] == c.stamp)
+		{
+			continue;
+		}
+		c.mark[s] = c.stamp;
+		const nfa_state &st = nfa[s];
+		switch (st.type)
+		{
+		case BYTES:
+			ids.push_back(s);
+			break;
+		case SPLIT:
+			stack.push_back(st.out2);
+			stack.push_back(st.out);
+			break;
+		case EPSILON:
+			stack.push_back(st.out);
+			break;
+		case MATCH:
+			ids.push_back(match_id(st.arg));
+			break;
+		}
+	}
+}
+
+int32_t LazyDFA::match_id(int32_t term) const
+{
+	/* the id a match of term has in a state: pending for whole word terms,
+	 counted otherwise */
+	return whole_word[term] ? num_nfa + term : num_nfa + num_terms + term;
+}
+
+void LazyDFA::step(cache &c, const vector<int32_t> &key, unsigned char b, vector<int32_t> &ids) const
+{
+	/* the state after reading b in the state described by key, unsorted but
+	 without repeats */
+
+	bool word = is_word(b);
+	ids.clear();
+	c.next_stamp();
+	for (int32_t s : key)
+	{
+		if (s < num_nfa)
+		{
+			if (sets[nfa[s].arg][b])
+			{
+				closure(c, nfa[s].out, ids);
+			}
+		}
+		// a pending whole word match ended before a non-letter
+		else if (s < num_nfa + num_terms && !word)
+		{
+			ids.push_back(s + num_terms);
+		}
+	}
+	// every term may start a new match here; whole words only after a non-letter
+	for (int32_t s : restart[word ? 1 : 0])
+	{
+		if (c.mark[s] != c.stamp)
+		{
+			c.mark[s] = c.stamp;
+			ids.push_back(nfa[s].type == MATCH ? match_id(nfa[s].arg) : s);
+		}
+	}
+}
+
+void LazyDFA::start(dfa_stream &ds, vector<int> &counts) const
+{
+	/* empty matches at the very start are counted here */
+
+	cache &c = thread_cache();
+	ds.key = start_key;
+	ds.state = c.intern(ds.key, num_nfa, num_terms);
+	ds.epoch = c.epoch;
+	for (int32_t o = c.out_start[ds.state]; o < c.out_start[ds.state + 1]; o++)
+	{
+		counts[c.out_terms[o]]++;
+	}
+}
+
+void LazyDFA::feed(dfa_stream &ds, const char *data, size_t len, vector<int> &counts) const
+{
+	cache &c = thread_cache();
+	size_t done = 0;
+	while (done < len)
+	{
+		if (c.simulate > 0)
+		{
+			size_t n = min(len - done, c.simulate);
+			simulate(c, ds, data + done, n, counts);
+			c.simulate -= n;
+			done += n;
+		}
+		else
+		{
+			done += run(c, ds, data + done, len - done, counts);
+		}
+	}
+}
+
+size_t LazyDFA::run(cache &c, dfa_stream &ds, const char *data, size_t len, vector<int> &counts) const
+{
+	/* scans with the cached states until the end of data, or until the cache
+	 fills up so fast that simulating the NFA is cheaper; returns the bytes
+	 scanned */
+
+	if (ds.epoch != c.epoch)
+	{
+		// keys are sorted, the simulation leaves them in any order
+		sort(ds.key.begin(), ds.key.end());
+		ds.state = c.intern(ds.key, num_nfa, num_terms);
+	}
+	int32_t s = ds.state;
+	const int K = num_classes;
+	const int32_t *next = c.next.data();
+	const int32_t *starts = c.out_start.data();
+	const int32_t *outs = c.out_terms.data();
+	// bytes before this were added to c.scanned already
+	size_t from = 0;
+	for (size_t i = 0; i < len; i++)
+	{
+		int cls = byte_class[(unsigned char)data[i]];
+		int32_t t = next[s * K + cls];
+		if (t < 0)
+		{
+			// first time this transition is taken, build its target
+			step(c, c.keys[s], class_byte[cls], c.target);
+			sort(c.target.begin(), c.target.end());
+			if (c.full())
+			{
+				c.scanned += i - from;
+				from = i;
+				bool thrashing = c.thrashing();
+				vector<int32_t> key = c.keys[s];
+				c.reset(id, num_classes, num_nfa);
+				if (thrashing)
+				{
+					c.simulate = SIMULATE_BYTES;
+					ds.key = key;
+					ds.epoch = 0;
+					return i;
+				}
+				s = c.intern(key, num_nfa, num_terms);
+			}
+			t = c.intern(c.target, num_nfa, num_terms);
+			c.next[s * K + cls] = t;
+			next = c.next.data();
+			starts = c.out_start.data();
+			outs = c.out_terms.data();
+		}
+		s = t;
+		for (int32_t o = starts[s]; o < starts[s + 1]; o++)
+		{
+			counts[outs[o]]++;
+		}
+	}
+	c.scanned += len - from;
+	ds.state = s;
+	ds.epoch = c.epoch;
+	ds.key = c.keys[s];
+	return len;
+}
+
+void LazyDFA::simulate(cache &c, dfa_stream &ds, const char *data, size_t len, vector<int> &counts) const
+{
+	/* steps the set of NFA states a byte at a time without keeping any */
+
+	const int32_t counted = num_nfa + num_terms;
+	for (size_t i = 0; i < len; i++)
+	{
+		step(c, ds.key, (unsigned char)data[i], c.target);
+		ds.key.swap(c.target);
+		for (int32_t s : ds.key)
+		{
+			if (s >= counted)
+			{
+				counts[s - counted]++;
+			}
+		}
+	}
+	ds.epoch = 0;
+}
+
+void LazyDFA::finish(dfa_stream &ds, vector<int> &counts) const
+{
+	/* the end of a body confirms the pending whole word matches */
+
+	for (int32_t s : ds.key)
+	{
+		if (s >= num_nfa && s < num_nfa + num_terms)
+		{
+			counts[s - num_nfa]++;
+		}
+	}
+}
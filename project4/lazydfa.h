@@ -0,0 +1,119 @@
+// lazydfa.h
+
+#ifndef LAZYDFA_H
+#define LAZYDFA_H
+
+#include <string>
+#include <vector>
+#include <bitset>
+#include <stdint.h>
+
+using namespace std;
+
+// A search term line split into its pattern and modifiers.  "/body/flags"
+// with one or more flags out of i (ignore case), w (whole word) and r (body
+// is a regular expression) is a pattern term; every other line, including
+// one that merely starts with a slash, is an exact literal.
+struct term_spec
+{
+	string pattern;
+	bool icase = false;
+	bool word = false;
+	bool regex = false;
+};
+
+term_spec parse_term(const string &line);
+
+// scan position carried across chunks; state numbers are only good for the
+// cache they came from, so the state's key is kept to find it again
+struct dfa_stream
+{
+	int32_t state = 0;
+	uint64_t epoch = 0;
+	vector<int32_t> key;
+};
+
+// All terms compiled into one Thompson NFA, run as a DFA whose states are
+// built the first time a scan reaches them.  Each thread keeps its own cache
+// of built states and a byte-class-compressed transition table, cleared when
+// it grows too large; a thread whose cache fills up almost as fast as it
+// scans steps the NFA directly for a while instead.  A term is counted once
+// for every position a match of it ends at, so literals count overlapping
+// occurrences as before.  Whole word terms may not touch a letter, digit or
+// underscore on either side: they only start after a non-letter, and a DFA
+// state holds their matches as pending until the next byte (or the end of
+// the body) confirms them.
+class LazyDFA
+{
+public:
+	LazyDFA();
+
+	// returns a message for every regex that did not parse; those terms
+	// are searched for as exact literals of their whole line
+	vector<string> compile(const vector<string> &terms);
+
+	// streaming use: start, feed every chunk in order, then finish
+	void start(dfa_stream &ds, vector<int> &counts) const;
+	void feed(dfa_stream &ds, const char *data, size_t len, vector<int> &counts) const;
+	void finish(dfa_stream &ds, vector<int> &counts) const;
+
+private:
+	enum { BYTES, SPLIT, EPSILON, MATCH };
+	struct nfa_state
+	{
+		int type;
+		// BYTES: index into sets; MATCH: term
+		int32_t arg;
+		int32_t out;
+		int32_t out2;
+	};
+	// regex syntax tree, expanded into NFA states
+	struct node
+	{
+		enum { SET, CAT, ALT, REPEAT } type;
+		int32_t set = 0;
+		int min = 0;
+		int max = 0; // -1 for no limit
+		vector<node> kids;
+	};
+	struct fragment
+	{
+		int32_t start;
+		int32_t end;
+	};
+	class cache;
+
+	bool parse_regex(const string &re, bool icase, node &tree, string &error);
+	bool parse_alt(const string &re, size_t &pos, bool icase, node &tree, string &error);
+	bool parse_atom(const string &re, size_t &pos, bool icase, node &atom, string &error);
+	int32_t add_set(bitset<256> set, bool icase);
+	int32_t add_state(int type, int32_t arg, int32_t out, int32_t out2);
+	static size_t nfa_size(const node &tree);
+	fragment build(const node &tree);
+	void make_classes();
+
+	cache &thread_cache() const;
+	void step(cache &c, const vector<int32_t> &key, unsigned char b, vector<int32_t> &ids) const;
+	void closure(cache &c, int32_t root, vector<int32_t> &ids) const;
+	int32_t match_id(int32_t term) const;
+	size_t run(cache &c, dfa_stream &ds, const char *data, size_t len, vector<int> &counts) const;
+	void simulate(cache &c, dfa_stream &ds, const char *data, size_t len, vector<int> &counts) const;
+
+	uint64_t id;
+	int32_t num_nfa;
+	int32_t num_terms;
+	vector<nfa_state> nfa;
+	vector<bitset<256> > sets;
+	vector<int32_t> roots;
+	vector<char> whole_word;
+	// BYTES and MATCH states reached from the roots that may start a match
+	// after a non-letter [0] and after a letter [1]
+	vector<int32_t> restart[2];
+	vector<int32_t> start_key;
+	uint8_t byte_class[256];
+	int num_classes;
+	// one byte of every class, to compute its transitions from
+	vector<unsigned char> class_byte;
+};
+
+#endif
@@ -0,0 +1,230 @@
+// matcher.cpp
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <string.h>
+#include "matcher.h"
+#include "parsesite.h"
+#include "bodyhash.h"
+
+using namespace std;
+
+Matcher::Matcher()
+{
+	use_kernel = false;
+	use_dfa = false;
+	terms = make_shared<vector<string> >();
+	terms_id = 0;
+	memset(byte_class, 0, sizeof(byte_class));
+	num_classes = 1;
+	next.assign(1, 0);
+	out_start.assign(2, 0);
+}
+
+vector<string> Matcher::compile(const vector<string> &search_terms, size_t kernel_max_terms)
+{
+	/* builds the automaton: trie, failure links, then a flat transition table */
+
+	terms = make_shared<vector<string> >(search_terms);
+	const vector<string> &list = *terms;
+	empty_terms.clear();
+	string joined;
+	for (const string &t : list)
+	{
+		joined += t;
+		joined += '\n';
+	}
+	terms_id = body_hash(joined.data(), joined.size());
+	// terms with modifiers need the DFA, which then counts every term
+	use_dfa = false;
+	for (const string &t : list)
+	{
+		term_spec spec = parse_term(t);
+		use_dfa = use_dfa || spec.icase || spec.word || spec.regex;
+	}
+	if (use_dfa)
+	{
+		use_kernel = false;
+		return dfa.compile(list);
+	}
+	// a few separate vector scans beat one automaton scan
+	use_kernel = list.size() <= kernel_max_terms;
+
+	// give every byte used by a term its own class
+	memset(byte_class, 0, sizeof(byte_class));
+	num_classes = 1;
+	for (const string &t : list)
+	{
+		for (unsigned char c : t)
+		{
+			if (byte_class[c] == 0)
+			{
+				byte_class[c] = num_classes++;
+			}
+		}
+	}
+	int K = num_classes;
+
+	// build the trie, -1 marks a missing edge
+	next.assign(K, -1);
+	vector<vector<int32_t> > outputs(1);
+	for (size_t i = 0; i < list.size(); i++)
+	{
+		if (list[i].empty())
+		{
+			empty_terms.push_back(i);
+			continue;
+		}
+		int32_t s = 0;
+		for (unsigned char c : list[i])
+		{
+			int32_t &edge = next[s * K + byte_class[c]];
+			if (edge == -1)
+			{
+				edge = outputs.size();
+				outputs.push_back(vector<int32_t>());
+				next.resize(next.size() + K, -1);
+			}
+			// next may have moved, look the edge up again
+			s = next[s * K + byte_class[c]];
+		}
+		outputs[s].push_back(i);
+	}
+	size_t num_states = outputs.size();
+
+	// breadth first over the trie filling in failure transitions
+	vector<int32_t> fail(num_states, 0);
+	queue<int32_t> order;
+	for (int c = 0; c < K; c++)
+	{
+		if (next[c] == -1)
+		{
+			next[c] = 0;
+		}
+		else
+		{
+			fail[next[c]] = 0;
+			order.push(next[c]);
+		}
+	}
+	while (!order.empty())
+	{
+		int32_t u = order.front();
+		order.pop();
+		// a state also reports everything its failure state reports
+		const vector<int32_t> &inherited = outputs[fail[u]];
+		outputs[u].insert(outputs[u].end(), inherited.begin(), inherited.end());
+		for (int c = 0; c < K; c++)
+		{
+			int32_t v = next[u * K + c];
+			if (v == -1)
+			{
+				next[u * K + c] = next[fail[u] * K + c];
+			}
+			else
+			{
+				fail[v] = next[fail[u] * K + c];
+				order.push(v);
+			}
+		}
+	}
+
+	// flatten the output lists
+	out_start.assign(num_states + 1, 0);
+	out_terms.clear();
+	for (size_t s = 0; s < num_states; s++)
+	{
+		out_start[s] = out_terms.size();
+		out_terms.insert(out_terms.end(), outputs[s].begin(), outputs[s].end());
+	}
+	out_start[num_states] = out_terms.size();
+	return vector<string>();
+}
+
+vector<int> Matcher::count(const char *data, size_t len) const
+{
+	/* counts every term with a single scan over data */
+
+	vector<int> counts(terms->size(), 0);
+	if (use_dfa)
+	{
+		dfa_stream ds;
+		dfa.start(ds, counts);
+		dfa.feed(ds, data, len, counts);
+		dfa.finish(ds, counts);
+		return counts;
+	}
+	if (use_kernel)
+	{
+		for (size_t t = 0; t < terms->size(); t++)
+		{
+			counts[t] = count_occurrences(data, len, (*terms)[t]);
+		}
+		return counts;
+	}
+	scan(0, data, len, counts);
+	// an empty term is found before every byte and at the end
+	for (int32_t t : empty_terms)
+	{
+		counts[t] = len + 1;
+	}
+
+	return counts;
+}
+
+void Matcher::start(match_stream &ms) const
+{
+	ms.state = 0;
+	ms.bytes = 0;
+	ms.counts.assign(terms->size(), 0);
+	if (use_dfa)
+	{
+		dfa.start(ms.dfa, ms.counts);
+	}
+}
+
+void Matcher::feed(match_stream &ms, const char *data, size_t len) const
+{
+	/* always uses the automaton, its state is all that spans chunks */
+	if (use_dfa)
+	{
+		dfa.feed(ms.dfa, data, len, ms.counts);
+		return;
+	}
+	ms.state = scan(ms.state, data, len, ms.counts);
+	ms.bytes += len;
+}
+
+vector<int> Matcher::finish(match_stream &ms) const
+{
+	if (use_dfa)
+	{
+		dfa.finish(ms.dfa, ms.counts);
+		return move(ms.counts);
+	}
+	for (int32_t t : empty_terms)
+	{
+		ms.counts[t] = ms.bytes + 1;
+	}
+	return move(ms.counts);
+}
+
+int32_t Matcher::scan(int32_t s, const char *data, size_t len, vector<int> &counts) const
+{
+	/* runs the automaton from state s over data, returning the final state */
+
+	const int32_t *table = next.data();
+	const int32_t *starts = out_start.data();
+	const int32_t *outs = out_terms.data();
+	int K = num_classes;
+	for (size_t i = 0; i < len; i++)
+	{
+		s = table[s * K + byte_class[(unsigned char)data[i]]];
+		for (int32_t o = starts[s]; o < starts[s + 1]; o++)
+		{
+			counts[outs[o]]++;
+		}
+	}
+	return s;
+}
@@ -0,0 +1,78 @@
+// matcher.h
+
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+#include "lazydfa.h"
+
+using namespace std;
+
+// scan position carried across chunks when counting while downloading
+struct match_stream
+{
+	int32_t state = 0;
+	size_t bytes = 0;
+	vector<int> counts;
+	dfa_stream dfa;
+};
+
+// Aho-Corasick automaton counting every search term in one pass over a body.
+// Overlapping matches are counted, the same as count_occurrences.  Term lists
+// with /pattern/flags terms are compiled into a LazyDFA instead.
+class Matcher
+{
+public:
+	Matcher();
+
+	// builds the automaton from the search terms; lists of at most
+	// kernel_max_terms terms are counted with count_occurrences instead.
+	// Returns a message for every pattern term that did not compile
+	vector<string> compile(const vector<string> &terms, size_t kernel_max_terms = 0);
+
+	// occurrences of each term in data, indexed like the compiled terms
+	vector<int> count(const char *data, size_t len) const;
+	vector<int> count(const string &body) const { return count(body.data(), body.size()); }
+
+	// streaming counts: start, feed every chunk in order, then finish; a term
+	// split across two chunks is still counted
+	void start(match_stream &ms) const;
+	void feed(match_stream &ms, const char *data, size_t len) const;
+	vector<int> finish(match_stream &ms) const;
+
+	size_t num_terms() const { return terms->size(); }
+	const string &term(size_t i) const { return (*terms)[i]; }
+	// identifies the term list, counts made with a different one are stale
+	uint64_t fingerprint() const { return terms_id; }
+	// the compiled terms, shared with result records
+	shared_ptr<const vector<string> > term_list() const { return terms; }
+
+private:
+	int32_t scan(int32_t s, const char *data, size_t len, vector<int> &counts) const;
+
+	shared_ptr<const vector<string> > terms;
+	uint64_t terms_id;
+	// count each term with the vector substring kernel
+	bool use_kernel;
+	// some terms have modifiers, count with the lazy DFA
+	bool use_dfa;
+	LazyDFA dfa;
+	// bytes that never appear in a term share class 0; wider than a byte as
+	// terms using every byte value need 257 classes
+	uint16_t byte_class[256];
+	int num_classes;
+	// next[state * num_classes + class], fully resolved so the scan never
+	// follows failure links
+	vector<int32_t> next;
+	// terms ending at state s are out_terms[out_start[s] .. out_start[s+1])
+	vector<int32_t> out_start;
+	vector<int32_t> out_terms;
+	// empty terms match at every position
+	vector<int32_t> empty_terms;
+};
+
+#endif
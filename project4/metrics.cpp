@@ -0,0 +1,157 @@
+// metrics.cpp
+
+#include <string>
+#include <map>
+#include <ostream>
+#include "metrics.h"
+
+using namespace std;
+
+Metrics metrics;
+
+Histogram::Histogram()
+{
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		buckets[i].store(0, memory_order_relaxed);
+	}
+	total.store(0, memory_order_relaxed);
+	sum.store(0, memory_order_relaxed);
+	max.store(0, memory_order_relaxed);
+}
+
+int Histogram::bucket_of(uint64_t value)
+{
+	/* values below 8 get exact buckets, above that the top 3 bits below the
+	 leading one pick the sub-bucket */
+	if (value < (1u << SUB_BITS))
+	{
+		return value;
+	}
+	int log = 63 - __builtin_clzll(value);
+	int sub = (value >> (log - SUB_BITS)) & ((1 << SUB_BITS) - 1);
+	return ((log - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+uint64_t Histogram::bucket_top(int bucket)
+{
+	/* largest value that lands in bucket */
+	if (bucket < (1 << SUB_BITS))
+	{
+		return bucket;
+	}
+	int log = (bucket >> SUB_BITS) + SUB_BITS - 1;
+	uint64_t sub = bucket & ((1 << SUB_BITS) - 1);
+	uint64_t low = (1ULL << log) + (sub << (log - SUB_BITS));
+	return low + (1ULL << (log - SUB_BITS)) - 1;
+}
+
+void Histogram::record(uint64_t value)
+{
+	buckets[bucket_of(value)].fetch_add(1, memory_order_relaxed);
+	total.fetch_add(1, memory_order_relaxed);
+	sum.fetch_add(value, memory_order_relaxed);
+	uint64_t seen = max.load(memory_order_relaxed);
+	while (value > seen && !max.compare_exchange_weak(seen, value, memory_order_relaxed))
+	{
+	}
+}
+
+uint64_t Histogram::percentile(double p) const
+{
+	uint64_t n = count();
+	if (n == 0)
+	{
+		return 0;
+	}
+	uint64_t rank = (uint64_t)(p * n);
+	uint64_t seen = 0;
+	for (int i = 0; i < BUCKETS; i++)
+	{
+		seen += buckets[i].load(memory_order_relaxed);
+		if (seen > rank)
+		{
+			uint64_t top = bucket_top(i);
+			uint64_t most = max.load(memory_order_relaxed);
+			return top < most ? top : most;
+		}
+	}
+	return max.load(memory_order_relaxed);
+}
+
+void Histogram::report(ostream &out, const string &name) const
+{
+	uint64_t n = count();
+	out << name << " count=" << n
+		<< " mean=" << (n ? sum.load(memory_order_relaxed) / n : 0)
+		<< " p50=" << percentile(0.50)
+		<< " p90=" << percentile(0.90)
+		<< " p99=" << percentile(0.99)
+		<< " max=" << max.load(memory_order_relaxed) << "\n";
+}
+
+Metrics::Metrics()
+{
+	bytes.store(0);
+	decoded_bytes.store(0);
+	fetches_ok.store(0);
+	fetches_failed.store(0);
+	results_written.store(0);
+}
+
+void Metrics::run_started(int run)
+{
+	unique_lock<mutex> lock(m_runs);
+	runs[run].started = chrono::steady_clock::now();
+}
+
+void Metrics::fetch_queued(int run)
+{
+	unique_lock<mutex> lock(m_runs);
+	runs[run].outstanding++;
+}
+
+void Metrics::fetch_finished(int run)
+{
+	unique_lock<mutex> lock(m_runs);
+	map<int, run_state>::iterator it = runs.find(run);
+	if (it == runs.end())
+	{
+		return;
+	}
+	it->second.outstanding--;
+	it->second.last_done = chrono::steady_clock::now();
+	finish_run(it);
+}
+
+void Metrics::run_closed(int run)
+{
+	unique_lock<mutex> lock(m_runs);
+	map<int, run_state>::iterator it = runs.find(run);
+	if (it == runs.end())
+	{
+		return;
+	}
+	it->second.closed = true;
+	finish_run(it);
+}
+
+void Metrics::finish_run(map<int, run_state>::iterator it)
+{
+	/* a closed run with nothing outstanding is complete */
+	run_state &r = it->second;
+	if (!r.closed || r.outstanding > 0)
+	{
+		return;
+	}
+	if (r.last_done > r.started)
+	{
+		cycle.record(chrono::duration_cast<chrono::milliseconds>(r.last_done - r.started).count());
+	}
+	runs.erase(it);
+}
+
+uint64_t micros_since(chrono::steady_clock::time_point t)
+{
+	return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - t).count();
+}
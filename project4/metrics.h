@@ -0,0 +1,92 @@
+// metrics.h
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <stdint.h>
+
+using namespace std;
+
+// Log-linear histogram: every power of two is split into 8 sub-buckets, so
+// percentiles are within 12.5%.  record() is a handful of relaxed atomic
+// adds and never takes a lock.
+class Histogram
+{
+public:
+	Histogram();
+	void record(uint64_t value);
+	uint64_t count() const { return total.load(memory_order_relaxed); }
+	// approximate value below which fraction p of the samples fall
+	uint64_t percentile(double p) const;
+	// one line: count, mean, p50, p90, p99, max
+	void report(ostream &out, const string &name) const;
+
+private:
+	static const int SUB_BITS = 3;
+	static const int BUCKETS = 64 << SUB_BITS;
+	static int bucket_of(uint64_t value);
+	static uint64_t bucket_top(int bucket);
+
+	atomic<uint64_t> buckets[BUCKETS];
+	atomic<uint64_t> total;
+	atomic<uint64_t> sum;
+	atomic<uint64_t> max;
+};
+
+// counters and histograms for every stage of site-tester
+struct Metrics
+{
+	// fetch timings from curl, microseconds
+	Histogram dns;
+	Histogram connect;
+	Histogram tls;
+	Histogram ttfb;
+	Histogram transfer;
+	// bodies: time waiting in the parses queue and time counting, microseconds
+	Histogram queue_wait;
+	Histogram parse;
+	// from a run starting until its last site has results, milliseconds
+	Histogram cycle;
+
+	// bytes on the wire, and the same bodies after decoding
+	atomic<uint64_t> bytes;
+	atomic<uint64_t> decoded_bytes;
+	atomic<uint64_t> fetches_ok;
+	atomic<uint64_t> fetches_failed;
+	atomic<uint64_t> results_written;
+
+	Metrics();
+
+	// run bookkeeping for the cycle histogram
+	void run_started(int run);
+	void fetch_queued(int run);
+	void fetch_finished(int run);
+	// no more fetches will be queued for run
+	void run_closed(int run);
+
+private:
+	struct run_state
+	{
+		chrono::steady_clock::time_point started;
+		chrono::steady_clock::time_point last_done;
+		int outstanding = 0;
+		bool closed = false;
+	};
+	void finish_run(map<int, run_state>::iterator it);
+
+	mutex m_runs;
+	map<int, run_state> runs;
+};
+
+extern Metrics metrics;
+
+// microseconds since t
+uint64_t micros_since(chrono::steady_clock::time_point t);
+
+#endif
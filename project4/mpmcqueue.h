@@ -0,0 +1,236 @@
+// mpmcqueue.h
+
+#ifndef MPMCQUEUE_H
+#define MPMCQUEUE_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <stddef.h>
+
+using namespace std;
+
+// Bounded multi-producer/multi-consumer ring buffer.  try_push and try_pop
+// are lock-free (each cell carries a sequence number telling producers and
+// consumers whose turn it is).  push and pop apply backpressure: they spin
+// for a while and then sleep on a condition variable, which is only touched
+// when somebody is actually waiting.
+template <typename T>
+class MPMCQueue
+{
+public:
+	// capacity is rounded up to a power of two; spin is how many failed
+	// attempts push/pop make before blocking
+	MPMCQueue(size_t capacity, int spin = 64)
+	{
+		size_t n = 2;
+		while (n < capacity)
+		{
+			n <<= 1;
+		}
+		cells.reset(new cell[n]);
+		for (size_t i = 0; i < n; i++)
+		{
+			cells[i].seq.store(i, memory_order_relaxed);
+		}
+		mask = n - 1;
+		spins = spin;
+		head.store(0, memory_order_relaxed);
+		tail.store(0, memory_order_relaxed);
+		push_waiters.store(0, memory_order_relaxed);
+		pop_waiters.store(0, memory_order_relaxed);
+	}
+
+	// moves item in and returns true, or leaves it alone when full
+	bool try_push(T &item)
+	{
+		if (!enqueue(item))
+		{
+			return false;
+		}
+		wake(pop_waiters, not_empty);
+		return true;
+	}
+
+	// moves the oldest item out, false when empty
+	bool try_pop(T &item)
+	{
+		if (!dequeue(item))
+		{
+			return false;
+		}
+		wake(push_waiters, not_full);
+		return true;
+	}
+
+	// waits while the queue is full
+	void push(T item)
+	{
+		for (int i = 0; i < spins; i++)
+		{
+			if (try_push(item))
+			{
+				return;
+			}
+			this_thread::yield();
+		}
+		unique_lock<mutex> lock(m);
+		push_waiters.fetch_add(1);
+		atomic_thread_fence(memory_order_seq_cst);
+		while (!enqueue(item))
+		{
+			not_full.wait_for(lock, chrono::milliseconds(10));
+		}
+		push_waiters.fetch_sub(1);
+		lock.unlock();
+		wake(pop_waiters, not_empty);
+	}
+
+	// waits while the queue is empty
+	void pop(T &item)
+	{
+		pop_until(item, chrono::steady_clock::time_point::max());
+	}
+
+	// waits at most timeout_ms for an item, false if none came
+	bool pop_for(T &item, int timeout_ms)
+	{
+		return pop_until(item, chrono::steady_clock::now() + chrono::milliseconds(timeout_ms));
+	}
+
+	// approximate number of queued items
+	size_t size() const
+	{
+		size_t t = tail.load(memory_order_relaxed);
+		size_t h = head.load(memory_order_relaxed);
+		return t > h ? t - h : 0;
+	}
+	bool empty() const { return size() == 0; }
+	size_t capacity() const { return mask + 1; }
+
+private:
+	struct cell
+	{
+		atomic<size_t> seq;
+		T data;
+	};
+
+	bool pop_until(T &item, chrono::steady_clock::time_point deadline)
+	{
+		for (int i = 0; i < spins; i++)
+		{
+			if (try_pop(item))
+			{
+				return true;
+			}
+			this_thread::yield();
+		}
+		unique_lock<mutex> lock(m);
+		pop_waiters.fetch_add(1);
+		atomic_thread_fence(memory_order_seq_cst);
+		bool popped;
+		while (!(popped = dequeue(item)) && chrono::steady_clock::now() < deadline)
+		{
+			not_empty.wait_for(lock, chrono::milliseconds(10));
+		}
+		pop_waiters.fetch_sub(1);
+		lock.unlock();
+		if (popped)
+		{
+			wake(push_waiters, not_full);
+		}
+		return popped;
+	}
+
+	bool enqueue(T &item)
+	{
+		size_t pos = tail.load(memory_order_relaxed);
+		for (;;)
+		{
+			cell &c = cells[pos & mask];
+			size_t seq = c.seq.load(memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				// the cell is free, claim it
+				if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					c.data = move(item);
+					c.seq.store(pos + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// a whole lap behind: full
+				return false;
+			}
+			else
+			{
+				pos = tail.load(memory_order_relaxed);
+			}
+		}
+	}
+
+	bool dequeue(T &item)
+	{
+		size_t pos = head.load(memory_order_relaxed);
+		for (;;)
+		{
+			cell &c = cells[pos & mask];
+			size_t seq = c.seq.load(memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+			if (diff == 0)
+			{
+				// the cell holds data, claim it
+				if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed))
+				{
+					item = move(c.data);
+					c.seq.store(pos + mask + 1, memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// nothing written here yet: empty
+				return false;
+			}
+			else
+			{
+				pos = head.load(memory_order_relaxed);
+			}
+		}
+	}
+
+	void wake(atomic<int> &waiters, condition_variable &cv)
+	{
+		// pairs with the fence taken by a thread before it starts waiting
+		atomic_thread_fence(memory_order_seq_cst);
+		if (waiters.load(memory_order_relaxed) > 0)
+		{
+			lock_guard<mutex> lock(m);
+			cv.notify_all();
+		}
+	}
+
+	unique_ptr<cell[]> cells;
+	size_t mask;
+	int spins;
+	// producers and consumers each get their own cache line; padded rather
+	// than alignas(64) because gnu++11 operator new ignores over-alignment
+	char pad_cells[64];
+	atomic<size_t> tail;
+	char pad_tail[64];
+	atomic<size_t> head;
+	char pad_head[64];
+	atomic<int> push_waiters;
+	atomic<int> pop_waiters;
+	mutex m;
+	condition_variable not_full;
+	condition_variable not_empty;
+};
+
+#endif
@@ -5,6 +5,7 @@
 #include<sstream>
 #include<string>
 #include<vector>
+#include<algorithm>
 #include "parse.h"
 
 using namespace std;
@@ -22,4 +23,44 @@ vector<string> parseFile(string filename)
 	return searchTerms;
 }
 
+vector<site_entry> parseSites(string filename, int default_period)
+{
+	/* each line is a url, optionally followed by its own period */
+
+	vector<site_entry> sites;
+	for (string line : parseFile(filename))
+	{
+		istringstream fields(line);
+		site_entry site;
+		if (!(fields >> site.url))
+		{
+			continue;
+		}
+		if (!(fields >> site.period) || site.period <= 0)
+		{
+			site.period = default_period;
+		}
+		sites.push_back(site);
+	}
+
+	return sites;
+}
 
+string url_host(const string &url)
+{
+	/* host (and port) part of a url */
+
+	string::size_type begin = url.find("://");
+	begin = (begin == string::npos) ? 0 : begin + 3;
+	string::size_type end = url.find_first_of("/?#", begin);
+	string host = url.substr(begin, end == string::npos ? string::npos : end - begin);
+	// drop any user:password@
+	string::size_type at = host.rfind('@');
+	if (at != string::npos)
+	{
+		host = host.substr(at + 1);
+	}
+	transform(host.begin(), host.end(), host.begin(), ::tolower);
+
+	return host;
+}
@@ -1,4 +1,7 @@
 #include<string>
 #include<vector>
+#include "sitedata.h"
 using namespace std;
 vector<string> parseFile(string filename);
+vector<site_entry> parseSites(string filename, int default_period);
+string url_host(const string &url);
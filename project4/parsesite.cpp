@@ -1,16 +1,125 @@
 //parsesite.cpp
 #include <iostream>
 #include <string>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PARSESITE_X86
+#endif
+
+#include "parsesite.h"
 
 using namespace std;
 
-int count_occurrences(string site, string search) {
-	int occurrences = 0;
-	string::size_type pos = 0;
-	while ((pos = site.find(search, pos)) != string::npos) {
-		occurrences++;
+static size_t count_scalar(const char *site, size_t len, const char *search, size_t n) {
+	/* byte-at-a-time search, also used for the tails of the vector kernels */
+	size_t occurrences = 0;
+	if (n > len) {
+		return 0;
+	}
+	const char *pos = site;
+	const char *end = site + len - n + 1;
+	while ((pos = (const char *)memchr(pos, search[0], end - pos)) != NULL) {
+		if (memcmp(pos, search, n) == 0) {
+			occurrences++;
+		}
 		pos += 1;
 	}
-	
+
+	return occurrences;
+}
+
+#ifdef PARSESITE_X86
+
+/* Candidate filter: compare the first and last byte of the needle against
+ 16 or 32 positions at once and only memcmp where both match.  Every start
+ position is tested, so overlapping matches are counted like find(). */
+
+__attribute__((target("sse2")))
+static size_t count_sse2(const char *site, size_t len, const char *search, size_t n) {
+	size_t occurrences = 0;
+	size_t i = 0;
+	const __m128i first = _mm_set1_epi8(search[0]);
+	const __m128i last = _mm_set1_epi8(search[n-1]);
+	for (; i + n - 1 + 16 <= len; i += 16) {
+		__m128i block_first = _mm_loadu_si128((const __m128i *)(site + i));
+		__m128i block_last = _mm_loadu_si128((const __m128i *)(site + i + n - 1));
+		unsigned mask = _mm_movemask_epi8(_mm_and_si128(
+			_mm_cmpeq_epi8(first, block_first), _mm_cmpeq_epi8(last, block_last)));
+		while (mask != 0) {
+			unsigned bit = __builtin_ctz(mask);
+			if (n <= 2 || memcmp(site + i + bit + 1, search + 1, n - 2) == 0) {
+				occurrences++;
+			}
+			mask &= mask - 1;
+		}
+	}
+	// finish the positions a full vector no longer fits behind
+	if (i < len) {
+		occurrences += count_scalar(site + i, len - i, search, n);
+	}
+
+	return occurrences;
+}
+
+__attribute__((target("avx2")))
+static size_t count_avx2(const char *site, size_t len, const char *search, size_t n) {
+	size_t occurrences = 0;
+	size_t i = 0;
+	const __m256i first = _mm256_set1_epi8(search[0]);
+	const __m256i last = _mm256_set1_epi8(search[n-1]);
+	for (; i + n - 1 + 32 <= len; i += 32) {
+		__m256i block_first = _mm256_loadu_si256((const __m256i *)(site + i));
+		__m256i block_last = _mm256_loadu_si256((const __m256i *)(site + i + n - 1));
+		unsigned mask = _mm256_movemask_epi8(_mm256_and_si256(
+			_mm256_cmpeq_epi8(first, block_first), _mm256_cmpeq_epi8(last, block_last)));
+		while (mask != 0) {
+			unsigned bit = __builtin_ctz(mask);
+			if (n <= 2 || memcmp(site + i + bit + 1, search + 1, n - 2) == 0) {
+				occurrences++;
+			}
+			mask &= mask - 1;
+		}
+	}
+	// the sse2 kernel mops up what is left
+	if (i < len) {
+		occurrences += count_sse2(site + i, len - i, search, n);
+	}
+
 	return occurrences;
 }
+
+#endif
+
+typedef size_t (*count_kernel)(const char *, size_t, const char *, size_t);
+
+static count_kernel pick_kernel() {
+	/* chooses the widest kernel this cpu supports */
+#ifdef PARSESITE_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return count_avx2;
+	}
+	if (__builtin_cpu_supports("sse2")) {
+		return count_sse2;
+	}
+#endif
+	return count_scalar;
+}
+
+int count_occurrences(const char *site, size_t len, const string &search) {
+	static const count_kernel kernel = pick_kernel();
+	// an empty term is found at every position, as with find()
+	if (search.empty()) {
+		return len + 1;
+	}
+	if (search.size() > len) {
+		return 0;
+	}
+	return kernel(site, len, search.data(), search.size());
+}
+
+int count_occurrences(const string &site, const string &search) {
+	return count_occurrences(site.data(), site.size(), search);
+}
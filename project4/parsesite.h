@@ -3,4 +3,6 @@
 
 using namespace std;
 
-int count_occurrences(string site, string search);
+// overlapping occurrences of search, using SSE2/AVX2 when the cpu has them
+int count_occurrences(const char *site, size_t len, const string &search);
+int count_occurrences(const string &site, const string &search);
@@ -0,0 +1,279 @@
+// resultlog.cpp
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <sstream>
+#include <stdio.h>
+#include <time.h>
+#include "resultlog.h"
+
+using namespace std;
+
+string format_fetchtime(time_t fetchtime)
+{
+	/* asctime format without the trailing newline */
+	struct tm datetm;
+	char buf[32];
+	gmtime_r(&fetchtime, &datetm);
+	asctime_r(&datetm, buf);
+	string timedate(buf);
+	if (!timedate.empty() && timedate[timedate.size()-1] == '\n')
+	{
+		timedate.erase(timedate.size()-1);
+	}
+	return timedate;
+}
+
+string format_count(int count)
+{
+	return count < 0 ? "failure" : to_string(count);
+}
+
+LogDictionary::LogDictionary()
+{
+	file = NULL;
+}
+
+LogDictionary::~LogDictionary()
+{
+	if (file != NULL)
+	{
+		fclose(file);
+	}
+}
+
+bool LogDictionary::open(const string &filename, bool writable)
+{
+	/* loads the names logged so far */
+
+	ifstream infile(filename);
+	string line;
+	while (getline(infile, line))
+	{
+		ids[line] = names.size();
+		names.push_back(line);
+	}
+	if (writable)
+	{
+		file = fopen(filename.c_str(), "a");
+		return file != NULL;
+	}
+	return true;
+}
+
+uint32_t LogDictionary::intern(const string &name)
+{
+	map<string, uint32_t>::iterator it = ids.find(name);
+	if (it != ids.end())
+	{
+		return it->second;
+	}
+	uint32_t id = names.size();
+	ids[name] = id;
+	names.push_back(name);
+	fprintf(file, "%s\n", name.c_str());
+	return id;
+}
+
+bool LogDictionary::find(const string &name, uint32_t &id) const
+{
+	map<string, uint32_t>::const_iterator it = ids.find(name);
+	if (it == ids.end())
+	{
+		return false;
+	}
+	id = it->second;
+	return true;
+}
+
+void LogDictionary::flush()
+{
+	if (file != NULL)
+	{
+		fflush(file);
+	}
+}
+
+ResultLog::ResultLog()
+{
+	records = NULL;
+	index = NULL;
+	num_records = 0;
+}
+
+ResultLog::~ResultLog()
+{
+	if (records != NULL)
+	{
+		fclose(records);
+	}
+	if (index != NULL)
+	{
+		fclose(index);
+	}
+}
+
+bool ResultLog::open(const string &prefix)
+{
+	/* opens (or creates) the log files for appending */
+
+	if (!sites.open(prefix + ".sites", true) || !terms.open(prefix + ".terms", true)
+		|| !lists.open(prefix + ".lists", true))
+	{
+		return false;
+	}
+	records = fopen((prefix + ".bin").c_str(), "ab");
+	index = fopen((prefix + ".idx").c_str(), "ab");
+	if (records == NULL || index == NULL)
+	{
+		return false;
+	}
+	// new records are numbered after the ones already there
+	fseeko(records, 0, SEEK_END);
+	num_records = ftello(records) / sizeof(log_record);
+	return true;
+}
+
+void ResultLog::append(int run, const string &site, time_t fetchtime,
+	const vector<string> &term_list, const vector<int> &counts)
+{
+	/* writes one block of records and its index entry */
+
+	log_block block;
+	block.run = run;
+	block.site_id = sites.intern(site);
+	block.timestamp = fetchtime;
+	block.first_record = num_records;
+	size_t rows = min(counts.size(), term_list.size());
+	block.num_records = rows;
+	vector<log_record> out(rows);
+	string list;
+	for (size_t t = 0; t < rows; t++)
+	{
+		out[t].run = run;
+		out[t].site_id = block.site_id;
+		out[t].term_id = terms.intern(term_list[t]);
+		out[t].count = counts[t];
+		out[t].timestamp = fetchtime;
+		list += (t == 0 ? "" : " ") + to_string(out[t].term_id);
+	}
+	block.term_list = lists.intern(list) + 1;
+	fwrite(out.data(), sizeof(log_record), out.size(), records);
+	fwrite(&block, sizeof(block), 1, index);
+	num_records += out.size();
+}
+
+void ResultLog::flush()
+{
+	// dictionaries first, then records, then the index pointing at them
+	sites.flush();
+	terms.flush();
+	lists.flush();
+	fflush(records);
+	fflush(index);
+}
+
+ResultLogReader::ResultLogReader()
+{
+	records = NULL;
+}
+
+ResultLogReader::~ResultLogReader()
+{
+	if (records != NULL)
+	{
+		fclose(records);
+	}
+}
+
+bool ResultLogReader::open(const string &prefix)
+{
+	/* loads the dictionaries and the whole index, records stay on disk */
+
+	LogDictionary lists;
+	if (!sites.open(prefix + ".sites", false) || !terms.open(prefix + ".terms", false)
+		|| !lists.open(prefix + ".lists", false))
+	{
+		return false;
+	}
+	for (size_t id = 0; id < lists.size(); id++)
+	{
+		istringstream list(lists.name(id));
+		map<uint32_t, uint32_t> position;
+		uint32_t term_id;
+		for (uint32_t n = 0; list >> term_id; n++)
+		{
+			// a term listed twice is found at its first position
+			position.insert(make_pair(term_id, n));
+		}
+		positions.push_back(position);
+	}
+	records = fopen((prefix + ".bin").c_str(), "rb");
+	FILE *idx = fopen((prefix + ".idx").c_str(), "rb");
+	if (records == NULL || idx == NULL)
+	{
+		if (idx != NULL)
+		{
+			fclose(idx);
+		}
+		return false;
+	}
+	log_block block;
+	while (fread(&block, sizeof(block), 1, idx) == 1)
+	{
+		index.push_back(block);
+		by_run[block.run].push_back(block);
+		by_site[block.site_id].push_back(block);
+	}
+	fclose(idx);
+	return true;
+}
+
+const vector<log_block> &ResultLogReader::run_blocks(uint32_t run) const
+{
+	static const vector<log_block> none;
+	map<uint32_t, vector<log_block> >::const_iterator it = by_run.find(run);
+	return it == by_run.end() ? none : it->second;
+}
+
+const vector<log_block> &ResultLogReader::site_blocks(uint32_t site_id) const
+{
+	static const vector<log_block> none;
+	map<uint32_t, vector<log_block> >::const_iterator it = by_site.find(site_id);
+	return it == by_site.end() ? none : it->second;
+}
+
+bool ResultLogReader::read_record(uint64_t n, log_record &record)
+{
+	fseeko(records, (off_t)n * sizeof(log_record), SEEK_SET);
+	return fread(&record, sizeof(log_record), 1, records) == 1;
+}
+
+bool ResultLogReader::term_position(const log_block &block, uint32_t term_id, uint32_t &position) const
+{
+	if (block.term_list == 0 || block.term_list > positions.size())
+	{
+		return false;
+	}
+	const map<uint32_t, uint32_t> &list = positions[block.term_list - 1];
+	map<uint32_t, uint32_t>::const_iterator it = list.find(term_id);
+	if (it == list.end())
+	{
+		return false;
+	}
+	position = it->second;
+	return true;
+}
+
+vector<log_record> ResultLogReader::read_block(const log_block &block)
+{
+	vector<log_record> out(block.num_records);
+	fseeko(records, (off_t)block.first_record * sizeof(log_record), SEEK_SET);
+	size_t got = fread(out.data(), sizeof(log_record), out.size(), records);
+	out.resize(got);
+	return out;
+}
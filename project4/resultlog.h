@@ -0,0 +1,131 @@
+// resultlog.h
+
+#ifndef RESULTLOG_H
+#define RESULTLOG_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+using namespace std;
+
+/* Binary results log, an alternative to the per-run csv files.  With the
+ prefix "results" it is made of five append-only files:
+
+	results.bin	fixed-width log_record entries, one per (body, term)
+	results.idx	one log_block per body: its run, site, term list and
+			where its records start in .bin
+	results.sites	site names, one per line; line n is site id n
+	results.terms	search terms, one per line; line n is term id n
+	results.lists	term lists, one per line as space-separated term ids
+			in record order; line n is list id n
+
+ The index finds a body by run and site, and its term list finds a term's
+ record within the body.  Records are written in native byte order. */
+
+struct log_record
+{
+	uint32_t run;
+	uint32_t site_id;
+	uint32_t term_id;
+	int32_t count;
+	int64_t timestamp;
+};
+
+struct log_block
+{
+	uint32_t run;
+	uint32_t site_id;
+	int64_t timestamp;
+	uint64_t first_record;
+	uint32_t num_records;
+	// 1 + list id of the block's terms, 0 for blocks logged without one
+	uint32_t term_list;
+};
+
+// the csv "Time" column for a fetch
+string format_fetchtime(time_t fetchtime);
+// the csv "Count" column; negative counts mark fetches that failed
+string format_count(int count);
+
+// names interned to ids, stored one per line in a dictionary file
+class LogDictionary
+{
+public:
+	LogDictionary();
+	~LogDictionary();
+	bool open(const string &filename, bool writable);
+	// id of name, appending it to the file when it is new
+	uint32_t intern(const string &name);
+	// id of name, false if it has never been logged
+	bool find(const string &name, uint32_t &id) const;
+	const string &name(uint32_t id) const { return names[id]; }
+	size_t size() const { return names.size(); }
+	void flush();
+
+private:
+	FILE *file;
+	vector<string> names;
+	map<string, uint32_t> ids;
+};
+
+// appends bodies' results; used only from the result writer thread
+class ResultLog
+{
+public:
+	ResultLog();
+	~ResultLog();
+	bool open(const string &prefix);
+	void append(int run, const string &site, time_t fetchtime,
+		const vector<string> &terms, const vector<int> &counts);
+	// makes everything appended so far visible to readers
+	void flush();
+
+private:
+	FILE *records;
+	FILE *index;
+	uint64_t num_records;
+	LogDictionary sites;
+	LogDictionary terms;
+	LogDictionary lists;
+};
+
+// reads a results log for export and queries
+class ResultLogReader
+{
+public:
+	ResultLogReader();
+	~ResultLogReader();
+	bool open(const string &prefix);
+
+	// every block, in the order bodies were written
+	const vector<log_block> &blocks() const { return index; }
+	// the blocks of one run or of one site, in the same order
+	const vector<log_block> &run_blocks(uint32_t run) const;
+	const vector<log_block> &site_blocks(uint32_t site_id) const;
+	// the records belonging to one block
+	vector<log_record> read_block(const log_block &block);
+	// record number n of the whole log
+	bool read_record(uint64_t n, log_record &record);
+	// where term_id's record sits within block, from the block's term list
+	bool term_position(const log_block &block, uint32_t term_id, uint32_t &position) const;
+
+	const LogDictionary &site_names() const { return sites; }
+	const LogDictionary &term_names() const { return terms; }
+
+private:
+	FILE *records;
+	vector<log_block> index;
+	// the index grouped by run and by site, built once on open
+	map<uint32_t, vector<log_block> > by_run;
+	map<uint32_t, vector<log_block> > by_site;
+	LogDictionary sites;
+	LogDictionary terms;
+	// position of each term id in each term list
+	vector<map<uint32_t, uint32_t> > positions;
+};
+
+#endif
@@ -0,0 +1,122 @@
+/*
+	results-tool.cpp
+	J. Patrick Lacher	and		James Marvin
+	jlacher1@nd.edu				jmarvin1@nd.edu
+	Operating Systems CSE 30341
+	Reads the binary results log written by site-tester
+*/
+
+// include c++ modules
+#include <iostream>
+#include <string>
+#include <vector>
+
+// include c modules
+#include <stdlib.h>
+
+// include custom c++ function files
+#include "resultlog.h"
+
+// namespace declaration
+using namespace std;
+
+void usage()
+{
+	cerr << "Usage:" << endl;
+	cerr << "\t./results-tool log-prefix export [run]" << endl;
+	cerr << "\t./results-tool log-prefix query site term" << endl;
+}
+
+int export_csv(ResultLogReader &log, int run)
+{
+	/* prints the log (or one run of it) in the site-tester csv format */
+
+	cout << "Time,Phrase,Site,Count" << endl;
+	// the index says which bodies belong to the run
+	for (const log_block &block : run > 0 ? log.run_blocks(run) : log.blocks())
+	{
+		string timedate = format_fetchtime(block.timestamp);
+		const string &site = log.site_names().name(block.site_id);
+		for (const log_record &record : log.read_block(block))
+		{
+			cout << timedate << "," << log.term_names().name(record.term_id) << ","
+				<< site << "," << format_count(record.count) << "\n";
+		}
+	}
+	return 0;
+}
+
+int query(ResultLogReader &log, const string &site, const string &term)
+{
+	/* count for term on site over time, reading one record per body */
+
+	uint32_t site_id, term_id;
+	if (!log.site_names().find(site, site_id))
+	{
+		cerr << "Error: " << site << " is not in the log" << endl;
+		return 1;
+	}
+	if (!log.term_names().find(term, term_id))
+	{
+		cerr << "Error: " << term << " is not in the log" << endl;
+		return 1;
+	}
+	cout << "Time,Run,Count" << endl;
+	for (const log_block &block : log.site_blocks(site_id))
+	{
+		// the block's term list says which of its records is the term's
+		log_record record;
+		uint32_t position;
+		bool found = false;
+		if (log.term_position(block, term_id, position))
+		{
+			found = log.read_record(block.first_record + position, record);
+		}
+		else if (block.term_list == 0)
+		{
+			// logged without a term list, look through the whole block
+			vector<log_record> records = log.read_block(block);
+			for (uint32_t i = 0; i < records.size() && !found; i++)
+			{
+				if (records[i].term_id == term_id)
+				{
+					record = records[i];
+					found = true;
+				}
+			}
+		}
+		if (found)
+		{
+			cout << format_fetchtime(record.timestamp) << "," << record.run << "," << format_count(record.count) << "\n";
+		}
+	}
+	return 0;
+}
+
+int main( int argc, char * argv[] )
+{
+	/* main program execution */
+
+	if (argc < 3)
+	{
+		usage();
+		return 1;
+	}
+	ResultLogReader log;
+	if (!log.open(argv[1]))
+	{
+		cerr << "Error: " << argv[1] << " is not a results log" << endl;
+		return 1;
+	}
+	string command = argv[2];
+	if (command.compare("export") == 0 && argc <= 4)
+	{
+		return export_csv(log, argc == 4 ? atoi(argv[3]) : 0);
+	}
+	if (command.compare("query") == 0 && argc == 5)
+	{
+		return query(log, argv[3], argv[4]);
+	}
+	usage();
+	return 1;
+}
@@ -0,0 +1,185 @@
+// resultwriter.cpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <fstream>
+#include <chrono>
+#include <iostream>
+#include <time.h>
+#include "resultwriter.h"
+#include "metrics.h"
+
+using namespace std;
+
+// run files kept open at once; older runs are closed and reopened on demand
+static const size_t MAX_OPEN_RUNS = 4;
+
+const string csv_header = "Time,Phrase,Site,Count\n";
+
+ResultWriter::ResultWriter(size_t flush_bytes, int flush_ms, bool write_csv, const string &log_prefix)
+{
+	this->flush_bytes = flush_bytes;
+	this->flush_ms = flush_ms;
+	this->write_csv = write_csv;
+	write_log = !log_prefix.empty();
+	log_failed = write_log && !log.open(log_prefix);
+	pending_bytes = 0;
+	stopping = false;
+	// nothing is written without the log it was asked for
+	if (!log_failed)
+	{
+		writer = thread(&ResultWriter::writer_thread_function, this);
+	}
+}
+
+ResultWriter::~ResultWriter()
+{
+	stop();
+}
+
+void ResultWriter::begin_run(int run_num)
+{
+	result_record record;
+	record.run_num = run_num;
+	record.header = true;
+	submit(move(record));
+}
+
+void ResultWriter::submit(result_record &&record)
+{
+	// rough size of the rows this record turns into
+	size_t bytes = record.counts.size() * (record.timedate.size() + record.source.size() + 24);
+	unique_lock<mutex> lock(m_pending);
+	pending.push_back(move(record));
+	pending_bytes += bytes;
+	if (pending_bytes >= flush_bytes)
+	{
+		cv_pending.notify_one();
+	}
+}
+
+void ResultWriter::stop()
+{
+	unique_lock<mutex> lock(m_pending);
+	stopping = true;
+	cv_pending.notify_one();
+	lock.unlock();
+	if (writer.joinable())
+	{
+		writer.join();
+	}
+}
+
+void ResultWriter::writer_thread_function()
+{
+	/* waits for a full batch or the flush interval, then writes it */
+
+	vector<result_record> batch;
+	while (1)
+	{
+		unique_lock<mutex> lock(m_pending);
+		cv_pending.wait_for(lock, chrono::milliseconds(flush_ms),
+			[this]{ return stopping || pending_bytes >= flush_bytes; });
+		batch.swap(pending);
+		pending_bytes = 0;
+		bool done = stopping;
+		lock.unlock();
+
+		write_batch(batch);
+		batch.clear();
+		if (done)
+		{
+			break;
+		}
+	}
+	for (auto &f : files)
+	{
+		f.second->close();
+		delete f.second;
+	}
+	files.clear();
+}
+
+void ResultWriter::write_batch(vector<result_record> &batch)
+{
+	/* formats the batch into one buffer per run and writes each once */
+
+	if (batch.empty())
+	{
+		return;
+	}
+	uint64_t rows = 0;
+	for (result_record &record : batch)
+	{
+		rows += record.header ? 0 : min(record.counts.size(), record.terms->size());
+	}
+	metrics.results_written.fetch_add(rows, memory_order_relaxed);
+	if (write_log)
+	{
+		for (result_record &record : batch)
+		{
+			if (!record.header)
+			{
+				log.append(record.run_num, record.source, record.fetchtime, *record.terms, record.counts);
+			}
+		}
+		log.flush();
+	}
+	if (!write_csv)
+	{
+		return;
+	}
+	map<int, string> out;
+	for (result_record &record : batch)
+	{
+		string &buf = out[record.run_num];
+		if (record.header)
+		{
+			buf += csv_header;
+			continue;
+		}
+		size_t rows = min(record.counts.size(), record.terms->size());
+		for (size_t t = 0; t < rows; t++)
+		{
+			buf += record.timedate;
+			buf += ',';
+			buf += (*record.terms)[t];
+			buf += ',';
+			buf += record.source;
+			buf += ',';
+			buf += format_count(record.counts[t]);
+			buf += '\n';
+		}
+	}
+	for (auto &run : out)
+	{
+		ofstream &outfile = run_file(run.first);
+		outfile.write(run.second.data(), run.second.size());
+		outfile.flush();
+	}
+}
+
+ofstream &ResultWriter::run_file(int run_num)
+{
+	/* returns the open file for a run, opening it if needed */
+
+	map<int, ofstream *>::iterator it = files.find(run_num);
+	if (it != files.end())
+	{
+		return *it->second;
+	}
+	// close the oldest run once too many are open
+	if (files.size() >= MAX_OPEN_RUNS)
+	{
+		files.begin()->second->close();
+		delete files.begin()->second;
+		files.erase(files.begin());
+	}
+	ofstream *outfile = new ofstream;
+	string filename = to_string(run_num) + ".csv";
+	outfile->open(filename, ofstream::out | ofstream::app);
+	files[run_num] = outfile;
+	return *outfile;
+}
@@ -0,0 +1,77 @@
+// resultwriter.h
+
+#ifndef RESULTWRITER_H
+#define RESULTWRITER_H
+
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <fstream>
+#include <time.h>
+
+#include "resultlog.h"
+
+using namespace std;
+
+// every term count found in one body
+struct result_record
+{
+	int run_num;
+	time_t fetchtime;
+	string timedate; // fetch time, formatted once per body
+	string source;
+	shared_ptr<const vector<string> > terms;
+	vector<int> counts;
+	bool header = false; // start of a run: write the csv header instead
+};
+
+// first line of every <run>.csv
+extern const string csv_header;
+
+// Owns the <run>.csv files.  Parse threads hand it whole bodies' worth of
+// results; a single thread formats them and writes them in batches, keeping
+// recent run files open between batches.
+class ResultWriter
+{
+public:
+	// batches are written once flush_bytes are pending or every flush_ms;
+	// results go to the csv files, the binary log at log_prefix, or both
+	ResultWriter(size_t flush_bytes, int flush_ms, bool write_csv, const string &log_prefix);
+	~ResultWriter();
+
+	// false when the binary log could not be opened; the writer then stays idle
+	bool good() const { return !log_failed; }
+
+	// writes the csv header for a new run
+	void begin_run(int run_num);
+	void submit(result_record &&record);
+	// writes everything submitted so far and stops the writer thread
+	void stop();
+
+private:
+	void writer_thread_function();
+	void write_batch(vector<result_record> &batch);
+	ofstream &run_file(int run_num);
+
+	size_t flush_bytes;
+	int flush_ms;
+	bool write_csv;
+	bool write_log;
+	bool log_failed;
+	// records waiting for the writer thread
+	mutex m_pending;
+	condition_variable cv_pending;
+	vector<result_record> pending;
+	size_t pending_bytes;
+	bool stopping;
+	// only touched by the writer thread
+	map<int, ofstream *> files;
+	ResultLog log;
+	thread writer;
+};
+
+#endif
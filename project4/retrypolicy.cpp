@@ -0,0 +1,73 @@
+// retrypolicy.cpp
+
+#include <string>
+#include <random>
+#include "retrypolicy.h"
+
+using namespace std;
+
+RetryPolicy::RetryPolicy(int max_retries, int base_ms, int cap_ms, int threshold, int cooldown)
+{
+	this->max_retries = max_retries;
+	this->base_ms = base_ms;
+	this->cap_ms = cap_ms;
+	this->threshold = threshold;
+	this->cooldown = chrono::seconds(cooldown);
+	random_device rd;
+	gen.seed(rd());
+}
+
+chrono::milliseconds RetryPolicy::backoff(int attempts)
+{
+	/* uniform in [0, min(cap, base * 2^attempts)] */
+
+	long ceiling = base_ms;
+	for (int i = 1; i < attempts && ceiling < cap_ms; i++)
+	{
+		ceiling *= 2;
+	}
+	if (ceiling > cap_ms)
+	{
+		ceiling = cap_ms;
+	}
+	unique_lock<mutex> lock(m_hosts);
+	uniform_int_distribution<long> jitter(0, ceiling);
+	return chrono::milliseconds(jitter(gen));
+}
+
+bool RetryPolicy::allow(const string &host)
+{
+	unique_lock<mutex> lock(m_hosts);
+	unordered_map<string, breaker>::iterator it = hosts.find(host);
+	if (it == hosts.end() || it->second.failures < threshold)
+	{
+		return true;
+	}
+	breaker &b = it->second;
+	// open: shed everything until the cooldown is over
+	if (chrono::steady_clock::now() < b.open_until || b.probing)
+	{
+		return false;
+	}
+	// half open: one fetch finds out whether the host is back
+	b.probing = true;
+	return true;
+}
+
+void RetryPolicy::success(const string &host)
+{
+	unique_lock<mutex> lock(m_hosts);
+	hosts.erase(host);
+}
+
+void RetryPolicy::failure(const string &host)
+{
+	unique_lock<mutex> lock(m_hosts);
+	breaker &b = hosts[host];
+	b.failures++;
+	b.probing = false;
+	if (b.failures >= threshold)
+	{
+		b.open_until = chrono::steady_clock::now() + cooldown;
+	}
+}
@@ -0,0 +1,51 @@
+// retrypolicy.h
+
+#ifndef RETRYPOLICY_H
+#define RETRYPOLICY_H
+
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <random>
+#include <chrono>
+
+using namespace std;
+
+// Decides when a failed fetch is tried again, and stops fetching from hosts
+// that keep failing.  Backoff is capped exponential with full jitter.  The
+// per-host circuit breaker opens after threshold consecutive failures, sheds
+// that host's fetches for cooldown seconds, then lets one probe through.
+class RetryPolicy
+{
+public:
+	RetryPolicy(int max_retries, int base_ms, int cap_ms, int threshold, int cooldown);
+
+	// true if a fetch that has failed attempts times should go again
+	bool should_retry(int attempts) const { return attempts <= max_retries; }
+	// how long to wait before the next attempt
+	chrono::milliseconds backoff(int attempts);
+
+	// false while the host's breaker is open
+	bool allow(const string &host);
+	void success(const string &host);
+	void failure(const string &host);
+
+private:
+	struct breaker
+	{
+		int failures = 0;
+		bool probing = false;
+		chrono::steady_clock::time_point open_until;
+	};
+
+	int max_retries;
+	int base_ms;
+	int cap_ms;
+	int threshold;
+	chrono::seconds cooldown;
+	mutex m_hosts;
+	unordered_map<string, breaker> hosts;
+	mt19937 gen;
+};
+
+#endif
@@ -0,0 +1,142 @@
+// scheduler.cpp
+
+#include <string>
+#include <vector>
+#include <map>
+#include <random>
+#include "scheduler.h"
+
+using namespace std;
+
+Scheduler::Scheduler(int period, bool spread, time_t run_start)
+{
+	this->period = chrono::seconds(period);
+	this->spread = spread;
+	start = clock::now();
+	if (run_start > 0)
+	{
+		// deadlines stay on the steady clock, only the origin is wall time
+		chrono::system_clock::time_point origin = chrono::system_clock::from_time_t(run_start);
+		start -= chrono::duration_cast<clock::duration>(chrono::system_clock::now() - origin);
+	}
+	stopped = false;
+}
+
+void Scheduler::set_sites(const vector<site_entry> &site_list)
+{
+	/* gives every new site its first deadline; sites already scheduled with
+	 the same period keep theirs, and pending retries stay queued */
+
+	unique_lock<mutex> lock(m_heap);
+	multimap<pair<string, int>, clock::time_point> kept;
+	vector<deadline> retries;
+	while (!heap.empty())
+	{
+		const deadline &d = heap.top();
+		if (d.once)
+		{
+			retries.push_back(d);
+		}
+		else
+		{
+			kept.insert(make_pair(make_pair(sites[d.site].url, sites[d.site].period), d.due));
+		}
+		heap.pop();
+	}
+	sites = site_list;
+	for (const deadline &d : retries)
+	{
+		heap.push(d);
+	}
+	random_device rd;
+	mt19937 gen(rd());
+	uniform_real_distribution<double> jitter(0.0, 1.0);
+	clock::time_point now = clock::now();
+	for (size_t i = 0; i < sites.size(); i++)
+	{
+		deadline d;
+		d.site = i;
+		d.once = false;
+		d.due = now;
+		multimap<pair<string, int>, clock::time_point>::iterator old = kept.find(make_pair(sites[i].url, sites[i].period));
+		if (old != kept.end())
+		{
+			d.due = old->second;
+			kept.erase(old);
+		}
+		else if (spread)
+		{
+			// site i starts somewhere in slot i of n equal slots of its period
+			double slot = (i + jitter(gen)) / sites.size();
+			chrono::duration<double> offset(slot * sites[i].period);
+			d.due += chrono::duration_cast<clock::duration>(offset);
+		}
+		heap.push(d);
+	}
+	cv_heap.notify_all();
+}
+
+bool Scheduler::next(fetch_data &fd)
+{
+	/* sleeps until the earliest deadline, then reschedules that site */
+
+	unique_lock<mutex> lock(m_heap);
+	while (!stopped)
+	{
+		if (heap.empty())
+		{
+			cv_heap.wait(lock);
+			continue;
+		}
+		deadline d = heap.top();
+		if (clock::now() < d.due)
+		{
+			cv_heap.wait_until(lock, d.due);
+			continue;
+		}
+		heap.pop();
+		if (d.once)
+		{
+			fd = d.fd;
+			return true;
+		}
+		fd = fetch_data();
+		fd.source = sites[d.site].url;
+		fd.run_num = run_at(d.due);
+		// fixed rate: the next deadline does not drift with scheduling delay
+		d.due += chrono::seconds(sites[d.site].period);
+		heap.push(d);
+		return true;
+	}
+	return false;
+}
+
+void Scheduler::retry(const fetch_data &fd, clock::duration delay)
+{
+	deadline d;
+	d.due = clock::now() + delay;
+	d.site = 0;
+	d.once = true;
+	d.fd = fd;
+	unique_lock<mutex> lock(m_heap);
+	heap.push(d);
+	// the new deadline may be the earliest
+	cv_heap.notify_all();
+}
+
+void Scheduler::stop()
+{
+	unique_lock<mutex> lock(m_heap);
+	stopped = true;
+	cv_heap.notify_all();
+}
+
+int Scheduler::run_at(clock::time_point t) const
+{
+	/* runs are consecutive PERIOD_FETCH windows starting at 1 */
+	if (t < start)
+	{
+		return 1;
+	}
+	return (t - start) / period + 1;
+}
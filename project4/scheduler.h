@@ -0,0 +1,64 @@
+// scheduler.h
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <string>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <time.h>
+
+#include "sitedata.h"
+
+using namespace std;
+
+// Min-heap of fetch deadlines.  Each site is fetched every period seconds
+// (its own, or PERIOD_FETCH); first fetches are spread over one period so a
+// long site list does not all start at once.  The calling thread sleeps on a
+// condition variable until the next deadline.
+class Scheduler
+{
+public:
+	typedef chrono::steady_clock clock;
+
+	// period is the length of one run; spread staggers the first fetches;
+	// run 1 began at unix time run_start, or begins now if it is 0
+	Scheduler(int period, bool spread, time_t run_start);
+
+	// sets the sites to fetch; may be called again while running, when sites
+	// still listed keep their deadlines
+	void set_sites(const vector<site_entry> &sites);
+	// waits for the next due site and fills in fd; false once stopped
+	bool next(fetch_data &fd);
+	// queues a one-off fetch of fd after delay, e.g. a retry
+	void retry(const fetch_data &fd, clock::duration delay);
+	// wakes next() and makes it return false
+	void stop();
+
+private:
+	struct deadline
+	{
+		clock::time_point due;
+		size_t site;
+		// one-off entries carry their own fetch and are not rescheduled
+		bool once;
+		fetch_data fd;
+		bool operator>(const deadline &other) const { return due > other.due; }
+	};
+
+	int run_at(clock::time_point t) const;
+
+	clock::duration period;
+	bool spread;
+	clock::time_point start;
+	vector<site_entry> sites;
+	priority_queue<deadline, vector<deadline>, greater<deadline> > heap;
+	mutex m_heap;
+	condition_variable cv_heap;
+	bool stopped;
+};
+
+#endif
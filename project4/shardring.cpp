@@ -0,0 +1,38 @@
+// shardring.cpp
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "shardring.h"
+#include "bodyhash.h"
+
+using namespace std;
+
+ShardRing::ShardRing(int shards, int points_per_shard)
+{
+	for (int s = 0; s < shards; s++)
+	{
+		for (int p = 0; p < points_per_shard; p++)
+		{
+			string name = "shard-" + to_string(s) + "-" + to_string(p);
+			ring.push_back(make_pair(body_hash(name.data(), name.size()), s));
+		}
+	}
+	sort(ring.begin(), ring.end());
+}
+
+int ShardRing::shard_of(const string &host) const
+{
+	if (ring.empty())
+	{
+		return 0;
+	}
+	uint64_t h = body_hash(host.data(), host.size());
+	vector<pair<uint64_t, int> >::const_iterator it = lower_bound(ring.begin(), ring.end(), make_pair(h, 0));
+	// past the last point wraps around to the first
+	if (it == ring.end())
+	{
+		it = ring.begin();
+	}
+	return it->second;
+}
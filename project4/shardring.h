@@ -0,0 +1,31 @@
+// shardring.h
+
+#ifndef SHARDRING_H
+#define SHARDRING_H
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <stdint.h>
+
+using namespace std;
+
+// Consistent hashing of hosts onto shards.  Every shard owns many points on a
+// ring of 64-bit hashes and a host belongs to the shard with the first point
+// at or after the host's hash, so changing the number of shards only moves
+// the hosts next to the points that were added or removed.  All sites of a
+// host land in one shard, keeping its per-host limit and warm connections in
+// one process.
+class ShardRing
+{
+public:
+	ShardRing(int shards, int points_per_shard = 128);
+
+	int shard_of(const string &host) const;
+
+private:
+	// (point, shard), sorted by point
+	vector<pair<uint64_t, int> > ring;
+};
+
+#endif
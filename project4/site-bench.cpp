@@ -0,0 +1,492 @@
+/*
+	site-bench.cpp
+	J. Patrick Lacher	and		James Marvin
+	jlacher1@nd.edu				jmarvin1@nd.edu
+	Operating Systems CSE 30341
+	Runs site-tester against a local synthetic web server and reports throughput
+*/
+
+// include c++ modules
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <iomanip>
+
+// include c modules
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+// namespace declaration
+using namespace std;
+
+// benchmark settings, given on the command line as KEY=value
+struct bench_config
+{
+	int pages = 200; // distinct urls served
+	int page_size = 65536; // bytes per page
+	int latency_ms = 0; // server delay before every response
+	double term_density = 2.0; // term hits per KB of page
+	double failure_rate = 0.0; // fraction of responses that are 500
+	int num_terms = 16; // search terms generated
+	int period = 2; // PERIOD_FETCH of the generated config
+	int duration = 10; // seconds site-tester runs for each combination
+	vector<int> fetch_threads = {1, 2, 4}; // NUM_FETCH values swept
+	vector<int> parse_threads = {1, 2, 4}; // NUM_PARSE values swept
+	string site_tester = "./site-tester";
+	// any other KEY=value is copied into the generated config
+	vector<string> extra;
+};
+
+// result of one site-tester run, read from its stats file
+struct bench_result
+{
+	double seconds = 0;
+	double sites = 0;
+	double bytes = 0;
+	double decoded = 0;
+	double parse_us = 0;
+	double cycles = 0;
+	double cycle_mean = 0;
+	double cycle_p50 = 0;
+	double cycle_p99 = 0;
+};
+
+bench_config bcfg;
+
+// generated pages, indexed by url number
+vector<string> pages;
+vector<string> terms;
+
+void usage()
+{
+	cerr << "Usage:" << endl;
+	cerr << "\t./site-bench [KEY=value ...]" << endl;
+	cerr << "Keys: PAGES PAGE_SIZE LATENCY_MS TERM_DENSITY FAILURE_RATE NUM_TERMS PERIOD DURATION" << endl;
+	cerr << "\tFETCH_THREADS=1,2,4 PARSE_THREADS=1,2,4 SITE_TESTER=./site-tester" << endl;
+	cerr << "Other keys are passed to site-tester's config file." << endl;
+}
+
+vector<int> parse_list(const string &value)
+{
+	vector<int> list;
+	istringstream fields(value);
+	string field;
+	while (getline(fields, field, ','))
+	{
+		if (atoi(field.c_str()) > 0)
+		{
+			list.push_back(atoi(field.c_str()));
+		}
+	}
+	return list;
+}
+
+bool parse_args(int argc, char * argv[])
+{
+	/* reads KEY=value arguments into bcfg */
+
+	for (int i = 1; i < argc; i++)
+	{
+		string arg = argv[i];
+		string::size_type eq = arg.find('=');
+		if (eq == string::npos)
+		{
+			return false;
+		}
+		string key = arg.substr(0, eq);
+		string value = arg.substr(eq + 1);
+		if (key.compare("PAGES")==0)
+		{
+			bcfg.pages = atoi(value.c_str());
+		}
+		else if (key.compare("PAGE_SIZE")==0)
+		{
+			bcfg.page_size = atoi(value.c_str());
+		}
+		else if (key.compare("LATENCY_MS")==0)
+		{
+			bcfg.latency_ms = atoi(value.c_str());
+		}
+		else if (key.compare("TERM_DENSITY")==0)
+		{
+			bcfg.term_density = atof(value.c_str());
+		}
+		else if (key.compare("FAILURE_RATE")==0)
+		{
+			bcfg.failure_rate = atof(value.c_str());
+		}
+		else if (key.compare("NUM_TERMS")==0)
+		{
+			bcfg.num_terms = atoi(value.c_str());
+		}
+		else if (key.compare("PERIOD")==0)
+		{
+			bcfg.period = atoi(value.c_str());
+		}
+		else if (key.compare("DURATION")==0)
+		{
+			bcfg.duration = atoi(value.c_str());
+		}
+		else if (key.compare("FETCH_THREADS")==0)
+		{
+			bcfg.fetch_threads = parse_list(value);
+		}
+		else if (key.compare("PARSE_THREADS")==0)
+		{
+			bcfg.parse_threads = parse_list(value);
+		}
+		else if (key.compare("SITE_TESTER")==0)
+		{
+			bcfg.site_tester = value;
+		}
+		else
+		{
+			bcfg.extra.push_back(arg);
+		}
+	}
+	// enforce sensible input
+	return bcfg.pages > 0 && bcfg.page_size > 0 && bcfg.num_terms > 0 && bcfg.period > 0
+		&& bcfg.duration > 0 && !bcfg.fetch_threads.empty() && !bcfg.parse_threads.empty();
+}
+
+void generate_pages()
+{
+	/* builds html pages of filler words with search terms scattered at the
+	 configured density, the same every run */
+
+	static const char *filler[] = {"the", "news", "<p>", "</p>", "<div class=\"story\">", "</div>",
+		"report", "<a href=\"/world\">", "</a>", "weather", "markets", "sports", "update", "<br>"};
+	const int num_filler = sizeof(filler) / sizeof(filler[0]);
+	mt19937 rng(12345);
+	for (int t = 0; t < bcfg.num_terms; t++)
+	{
+		terms.push_back("benchterm" + to_string(t));
+	}
+	// chance that the next word is a term
+	double term_chance = bcfg.term_density * 6.0 / 1024.0;
+	uniform_real_distribution<double> coin(0.0, 1.0);
+	for (int p = 0; p < bcfg.pages; p++)
+	{
+		string page = "<html><head><title>page " + to_string(p) + "</title></head><body>\n";
+		while ((int)page.size() < bcfg.page_size - 16)
+		{
+			if (coin(rng) < term_chance)
+			{
+				page += terms[rng() % terms.size()];
+			}
+			else
+			{
+				page += filler[rng() % num_filler];
+			}
+			page += ' ';
+		}
+		page += "</body></html>\n";
+		pages.push_back(page);
+	}
+}
+
+void send_all(int fd, const string &data)
+{
+	size_t sent = 0;
+	while (sent < data.size())
+	{
+		ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+		if (n <= 0)
+		{
+			return;
+		}
+		sent += n;
+	}
+}
+
+void connection_thread_function(int fd)
+{
+	/* answers keep-alive GET requests on one connection until it closes */
+
+	mt19937 rng(fd);
+	uniform_real_distribution<double> coin(0.0, 1.0);
+	string request;
+	char buf[4096];
+	while (1)
+	{
+		string::size_type end = request.find("\r\n\r\n");
+		if (end == string::npos)
+		{
+			ssize_t n = recv(fd, buf, sizeof(buf), 0);
+			if (n <= 0)
+			{
+				break;
+			}
+			request.append(buf, n);
+			continue;
+		}
+		// "GET /p<n>.html HTTP/1.1"
+		int page = -1;
+		sscanf(request.c_str(), "GET /p%d.html", &page);
+		request.erase(0, end + 4);
+		if (bcfg.latency_ms > 0)
+		{
+			this_thread::sleep_for(chrono::milliseconds(bcfg.latency_ms));
+		}
+		if (page < 0 || page >= (int)pages.size())
+		{
+			send_all(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+		}
+		else if (coin(rng) < bcfg.failure_rate)
+		{
+			send_all(fd, "HTTP/1.1 500 Internal Server Error\r\nContent-Length: 0\r\n\r\n");
+		}
+		else
+		{
+			const string &body = pages[page];
+			send_all(fd, "HTTP/1.1 200 OK\r\nContent-Type: text/html\r\nContent-Length: "
+				+ to_string(body.size()) + "\r\n\r\n");
+			send_all(fd, body);
+		}
+	}
+	close(fd);
+}
+
+void server_thread_function(int listener)
+{
+	/* one thread per connection, site-tester keeps them alive */
+
+	while (1)
+	{
+		int fd = accept(listener, NULL, NULL);
+		if (fd < 0)
+		{
+			continue;
+		}
+		thread(connection_thread_function, fd).detach();
+	}
+}
+
+int start_server()
+{
+	/* listens on an unused loopback port and returns it */
+
+	int listener = socket(AF_INET, SOCK_STREAM, 0);
+	int on = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = 0;
+	socklen_t len = sizeof(addr);
+	if (listener < 0 || bind(listener, (struct sockaddr *)&addr, len) < 0
+		|| listen(listener, 128) < 0 || getsockname(listener, (struct sockaddr *)&addr, &len) < 0)
+	{
+		return -1;
+	}
+	thread(server_thread_function, listener).detach();
+	return ntohs(addr.sin_port);
+}
+
+void remove_dir(const string &dir)
+{
+	/* site-tester only writes plain files into its directory */
+
+	DIR *d = opendir(dir.c_str());
+	if (d == NULL)
+	{
+		return;
+	}
+	struct dirent *entry;
+	while ((entry = readdir(d)) != NULL)
+	{
+		string name = entry->d_name;
+		if (name.compare(".") != 0 && name.compare("..") != 0)
+		{
+			unlink((dir + "/" + name).c_str());
+		}
+	}
+	closedir(d);
+	rmdir(dir.c_str());
+}
+
+void write_inputs(const string &dir, int port, int nf, int np)
+{
+	/* the sites, search terms and config site-tester reads */
+
+	ofstream sitefile(dir + "/Sites.txt");
+	for (int p = 0; p < bcfg.pages; p++)
+	{
+		sitefile << "http://127.0.0.1:" << port << "/p" << p << ".html\n";
+	}
+	ofstream searchfile(dir + "/Search.txt");
+	for (const string &term : terms)
+	{
+		searchfile << term << "\n";
+	}
+	ofstream configfile(dir + "/Config.txt");
+	configfile << "PERIOD_FETCH=" << bcfg.period << "\n";
+	configfile << "NUM_FETCH=" << nf << "\n";
+	configfile << "NUM_PARSE=" << np << "\n";
+	// every page is on one host and should be fetched together
+	configfile << "SPREAD_FETCHES=0\n";
+	configfile << "MAX_PER_HOST=0\n";
+	configfile << "STATS_FILE=stats.txt\n";
+	configfile << "STATS_PERIOD=1\n";
+	// the run ends with a SIGINT; do not wait long for stragglers
+	configfile << "SHUTDOWN_TIMEOUT=2\n";
+	for (const string &line : bcfg.extra)
+	{
+		configfile << line << "\n";
+	}
+}
+
+map<string, string> read_stats(const string &filename)
+{
+	/* "name value" and "name k=v k=v" lines, keyed name or name.k */
+
+	map<string, string> stats;
+	ifstream infile(filename);
+	string line;
+	while (getline(infile, line))
+	{
+		istringstream fields(line);
+		string name, field;
+		fields >> name;
+		while (fields >> field)
+		{
+			string::size_type eq = field.find('=');
+			if (eq == string::npos)
+			{
+				stats[name] = field;
+			}
+			else
+			{
+				stats[name + "." + field.substr(0, eq)] = field.substr(eq + 1);
+			}
+		}
+	}
+	return stats;
+}
+
+bool run_tester(int port, int nf, int np, bench_result &result)
+{
+	/* runs site-tester for the configured duration in a scratch directory */
+
+	char dir_template[] = "/tmp/site-bench.XXXXXX";
+	if (mkdtemp(dir_template) == NULL)
+	{
+		return false;
+	}
+	string dir = dir_template;
+	write_inputs(dir, port, nf, np);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		if (chdir(dir.c_str()) == 0)
+		{
+			execl(bcfg.site_tester.c_str(), bcfg.site_tester.c_str(), "Config.txt", (char *)NULL);
+		}
+		_exit(127);
+	}
+	if (pid < 0)
+	{
+		remove_dir(dir);
+		return false;
+	}
+	// site-tester writes its last stats snapshot as it shuts down
+	this_thread::sleep_for(chrono::seconds(bcfg.duration));
+	kill(pid, SIGINT);
+	waitpid(pid, NULL, 0);
+	map<string, string> stats = read_stats(dir + "/stats.txt");
+	remove_dir(dir);
+	if (stats.empty())
+	{
+		return false;
+	}
+	result.seconds = atof(stats["uptime_s"].c_str());
+	result.sites = atof(stats["fetches_ok"].c_str()) + atof(stats["fetches_failed"].c_str());
+	result.bytes = atof(stats["bytes_total"].c_str());
+	result.decoded = atof(stats["bytes_decoded_total"].c_str());
+	result.parse_us = atof(stats["parse_us.count"].c_str()) * atof(stats["parse_us.mean"].c_str());
+	result.cycles = atof(stats["cycle_ms.count"].c_str());
+	result.cycle_mean = atof(stats["cycle_ms.mean"].c_str());
+	result.cycle_p50 = atof(stats["cycle_ms.p50"].c_str());
+	result.cycle_p99 = atof(stats["cycle_ms.p99"].c_str());
+	return result.seconds > 0;
+}
+
+int main( int argc, char * argv[] )
+{
+	/* main program execution */
+
+	if (!parse_args(argc, argv))
+	{
+		usage();
+		return 1;
+	}
+	if (access(bcfg.site_tester.c_str(), X_OK) != 0)
+	{
+		cerr << "Error: " << bcfg.site_tester << " is not executable" << endl;
+		return 1;
+	}
+	// the child runs in the scratch directory
+	if (bcfg.site_tester[0] != '/')
+	{
+		char cwd[4096];
+		if (getcwd(cwd, sizeof(cwd)) != NULL)
+		{
+			bcfg.site_tester = string(cwd) + "/" + bcfg.site_tester;
+		}
+	}
+	generate_pages();
+	int port = start_server();
+	if (port < 0)
+	{
+		cerr << "Error: could not start the local server" << endl;
+		return 1;
+	}
+	cout << bcfg.pages << " pages of " << bcfg.page_size << " bytes on port " << port
+		<< ", " << bcfg.duration << "s per run" << endl;
+	cout << "fetch parse    sites/s       MB/s  parse MB/s  cycle p50 ms  cycle p99 ms" << endl;
+	for (int nf : bcfg.fetch_threads)
+	{
+		for (int np : bcfg.parse_threads)
+		{
+			bench_result r;
+			cout << setw(5) << nf << setw(6) << np;
+			if (!run_tester(port, nf, np, r))
+			{
+				cout << "  failed: no stats written" << endl;
+				continue;
+			}
+			// rates are over the time a cycle takes, not the idle wait for
+			// the next PERIOD_FETCH; a run whose first cycle never finished
+			// was busy the whole time
+			double busy = r.seconds;
+			double sites = r.sites;
+			if (r.cycles > 0 && r.cycle_mean > 0)
+			{
+				busy = r.cycle_mean / 1000.0;
+				sites = bcfg.pages;
+			}
+			double bytes = r.sites > 0 ? r.bytes / r.sites * sites : 0;
+			cout << fixed << setprecision(1)
+				<< setw(11) << sites / busy
+				<< setw(11) << bytes / busy / 1e6
+				<< setw(12) << (r.parse_us > 0 ? r.decoded / r.parse_us : 0)
+				<< setw(14) << r.cycle_p50
+				<< setw(14) << r.cycle_p99 << endl;
+		}
+	}
+	return 0;
+}
@@ -12,55 +12,115 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
-#include <queue>
 #include <thread>
 #include <mutex>
 #include <condition_variable>
 #include <algorithm>
 #include <chrono>
+#include <atomic>
 
 // include c modules
 #include <time.h>
+#include <stdio.h>
+#include <errno.h>
 #include <csignal>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
 
 // include custom c++ function files
-#include "curlsingle.h"
+#include "config.h"
+#include "sitedata.h"
+#include "curlmulti.h"
+#include "curlshare.h"
 #include "parse.h"
 #include "parsesite.h"
+#include "matcher.h"
+#include "htmltext.h"
+#include "mpmcqueue.h"
+#include "resultwriter.h"
+#include "scheduler.h"
+#include "fetchcache.h"
+#include "bodyhash.h"
+#include "retrypolicy.h"
+#include "hostqueue.h"
+#include "metrics.h"
+#include "threadpool.h"
+#include "stealqueues.h"
+#include "shardring.h"
+#include "coordinator.h"
 
 // namespace declaration
 using namespace std;
 
-// data structure for queues
-struct fetch_data
-{
-	int run_num;
-	string source;
-};
-struct parse_data
-{
-	time_t fetchtime;
-	string source;
-	string body;
-	int run_num;
-};
+// configuration options
+tester_config cfg;
+
+// search terms compiled for single pass counting; a reload swaps in a new
+// one, so readers take a reference with current_matcher() and keep counting
+// with it while the next one is built
+shared_ptr<const Matcher> matcher;
+// reloads of the input files run one at a time
+mutex m_reload;
+
+// create global queues, bounded so fetching cannot outrun parsing;
+// fetches are grouped by host so no host can take every fetch thread
+HostQueue *fetches;
+MPMCQueue<parse_data> *parses;
+
+// validators, body hashes and counts from earlier fetches
+FetchCache cache;
+
+// sleeps until sites are due, also holds delayed retries
+Scheduler *scheduler;
+
+// backoff and per-host circuit breakers for failed fetches
+RetryPolicy *retries;
+
+// single thread owning the results files
+ResultWriter *writer;
 
-// create global vectors
-vector<string> search_terms;
-vector<string> sites;
+// fetch and parse threads, resized at runtime when autoscaling
+ThreadPool *fetch_pool;
+ThreadPool *parse_pool;
+// bodies waiting for a worker of the work-stealing executor
+StealQueues<parse_data> *tasks;
 
-// create global queues
-queue<fetch_data> fetches;
-queue<parse_data> parses;
+// transfers in flight over every fetch thread
+atomic<int> fetch_inflight(0);
+
+// set once a signal asks for shutdown; transfers still running at the
+// deadline are abandoned
+atomic<bool> stopping(false);
+chrono::steady_clock::time_point shutdown_deadline;
+mutex m_stop;
+condition_variable cv_stop;
+
+// for the stats rates
+chrono::steady_clock::time_point started_at;
+
+bool wait_for_stop(chrono::steady_clock::duration d)
+{
+	/* sleeps for d, returning early with true once shutdown has begun */
+	unique_lock<mutex> lock(m_stop);
+	return cv_stop.wait_for(lock, d, []{ return stopping.load(); });
+}
+
+bool past_deadline()
+{
+	return stopping.load() && chrono::steady_clock::now() >= shutdown_deadline;
+}
 
-// create global mutexes
-mutex m_fetches;
-mutex m_parses;
-mutex m_results;
+shared_ptr<const Matcher> current_matcher()
+{
+	return atomic_load(&matcher);
+}
 
-// create global condition variables
-condition_variable cv_fetches;
-condition_variable cv_parses;
+uint64_t counts_id(const Matcher &m)
+{
+	/* counts depend on the terms and on whether markup was counted too */
+	return cfg.html_text ? ~m.fingerprint() : m.fingerprint();
+}
 
 bool file_exists(string filename)
 {
@@ -69,186 +129,602 @@ bool file_exists(string filename)
 	return infile.good();
 }
 
-void fetch_thread_function()
+void write_results(const Matcher &m, int run_num, time_t fetchtime, const string &source, vector<int> &counts)
+{
+	/* hands one body's counts, made with m's terms, to the writer thread */
+	
+	result_record record;
+	record.run_num = run_num;
+	record.fetchtime = fetchtime;
+	// format lookup time once for every term
+	record.timedate = format_fetchtime(fetchtime);
+	record.source = source;
+	record.terms = m.term_list();
+	record.counts = move(counts);
+	writer->submit(move(record));
+	metrics.fetch_finished(run_num);
+}
+
+void write_failure(const fetch_data &src, time_t fetchtime)
+{
+	/* records a fetch that was given up on as failure rows */
+	
+	shared_ptr<const Matcher> m = current_matcher();
+	vector<int> counts(m->num_terms(), -1);
+	write_results(*m, src.run_num, fetchtime, src.source, counts);
+}
+
+void start_fetch(CurlMulti &engine, fetch_data &src)
+{
+	/* hands a site to the engine, conditionally if we have seen it before */
+	
+	// shed fetches to hosts whose circuit breaker is open
+	string host = url_host(src.source);
+	if (!retries->allow(host))
+	{
+		fetches->done(host);
+		write_failure(src, time(NULL));
+		return;
+	}
+	shared_ptr<const Matcher> m = current_matcher();
+	if (cfg.cache)
+	{
+		cache.conditional(src, counts_id(*m), m->num_terms());
+	}
+	// record time curl commences
+	time_t f_time;
+	time(&f_time);
+	engine.add(src, f_time, cfg.stream_match ? m : nullptr);
+}
+
+void store_counts(const Matcher &m, const string &source, const string &etag, const string &last_modified,
+	uint64_t hash, const vector<int> &counts)
+{
+	/* remembers a page's counts for later unchanged fetches */
+	
+	cache_entry entry;
+	entry.etag = etag;
+	entry.last_modified = last_modified;
+	entry.hash = hash;
+	entry.terms_id = counts_id(m);
+	entry.counts = counts;
+	cache.store(source, entry);
+}
+
+bool finish_transfer(CurlMulti &engine, curl_transfer &done, parse_data &d)
+{
+	/* records a finished transfer, true when d holds a body still to be counted */
+	
+	// check transfer result for errors (timeout, server error)
+	string host = url_host(done.src.source);
+	if (!done.ok || done.status >= 500)
+	{
+		fetches->done(host);
+		retries->failure(host);
+		done.src.attempts++;
+		// try again later instead of tying up this thread
+		if (retries->should_retry(done.src.attempts))
+		{
+			scheduler->retry(done.src, retries->backoff(done.src.attempts));
+		}
+		else
+		{
+			write_failure(done.src, done.fetchtime);
+		}
+		return false;
+	}
+	retries->success(host);
+	// not modified, reuse the counts from the last fetch
+	if (done.status == 304)
+	{
+		shared_ptr<const Matcher> m = current_matcher();
+		vector<int> counts;
+		if (cache.counts(done.src.source, counts_id(*m), m->num_terms(), counts))
+		{
+			fetches->done(host);
+			write_results(*m, done.src.run_num, done.fetchtime, done.src.source, counts);
+			return false;
+		}
+		// the counts went stale meanwhile, fetch the whole page
+		done.src.if_none_match.clear();
+		done.src.if_modified_since.clear();
+		engine.add(done.src, done.fetchtime, cfg.stream_match ? m : nullptr);
+		return false;
+	}
+	// the host's slot is free for its next fetch
+	fetches->done(host);
+	// streamed transfers were counted during the download
+	if (cfg.stream_match)
+	{
+		if (cfg.cache)
+		{
+			store_counts(*done.matcher, done.src.source, done.etag, done.last_modified, 0, done.counts);
+		}
+		write_results(*done.matcher, done.src.run_num, done.fetchtime, done.src.source, done.counts);
+		return false;
+	}
+	// create data object for parsing, moving the body
+	d.fetchtime = done.fetchtime;
+	d.source = done.src.source;
+	d.body = move(done.body);
+	d.run_num = done.src.run_num;
+	d.etag = done.etag;
+	d.last_modified = done.last_modified;
+	d.queued = chrono::steady_clock::now();
+	return true;
+}
+
+uint64_t parse_body(parse_data &db)
+{
+	/* counts the terms in a fetched body and writes the results, returning
+	 the microseconds it took */
+	
+	metrics.queue_wait.record(micros_since(db.queued));
+	chrono::steady_clock::time_point started = chrono::steady_clock::now();
+	shared_ptr<const Matcher> m = current_matcher();
+	vector<int> counts;
+	uint64_t hash = 0;
+	// a body identical to the last one keeps its counts
+	bool unchanged = false;
+	if (cfg.cache)
+	{
+		hash = body_hash(db.body.data(), db.body.size());
+		unchanged = cache.unchanged(db.source, hash, counts_id(*m), m->num_terms(), counts);
+	}
+	if (!unchanged)
+	{
+		if (cfg.html_text)
+		{
+			// count in the visible text only
+			thread_local HtmlText html;
+			thread_local string text;
+			text.clear();
+			html.feed(db.body.data(), db.body.size(), text);
+			html.finish(text);
+			counts = m->count(text.data(), text.size());
+		}
+		else
+		{
+			// count occurences of every term in one pass
+			counts = m->count(db.body.data(), db.body.size());
+		}
+	}
+	if (cfg.cache)
+	{
+		store_counts(*m, db.source, db.etag, db.last_modified, hash, counts);
+	}
+	uint64_t took = micros_since(started);
+	metrics.parse.record(took);
+	// output data for each search term
+	write_results(*m, db.run_num, db.fetchtime, db.source, counts);
+	return took;
+}
+
+void fetch_thread_function(int id)
 {
 	/* function to control a fetch thread */
 	
-	// continue loop until program ends
+	// every fetch thread drives up to max_inflight transfers at once,
+	// counting terms as data arrives when stream_match is set
+	CurlMulti engine(cfg.max_inflight, cfg.html_text, cfg.compression);
+	int reported = 0;
+	// continue loop until the pool shrinks below this thread
 	while (1)
 	{
-		// lock m_fetches mutex
-		unique_lock<mutex> f_lock(m_fetches);
 		fetch_data src;
-		// get site from fetches queue
-		cv_fetches.wait(f_lock, []{return !fetches.empty();});
-		src = fetches.front();
-		fetches.pop();
-		// unlock m_fetches mutex
-		f_lock.unlock();
-		// record time curl commences
-		time_t f_time;
-		time(&f_time);
+		// past the pool size: take no new sites, leave once the engine is
+		// empty, or at shutdown once the deadline has passed
+		bool draining = id >= fetch_pool->size();
+		if (draining && (engine.inflight() == 0 || past_deadline()) && fetch_pool->retire(id))
+		{
+			return;
+		}
+		// while bodies take more memory than the budget, only the
+		// transfers already running carry on
+		bool throttled = BodyBuffer::over_budget();
+		if (!draining && throttled && engine.inflight() == 0)
+		{
+			BodyBuffer::wait_for_budget(100);
+			continue;
+		}
+		// only block for new sites when nothing is in flight
+		if (!draining && engine.inflight() == 0 && fetches->pop_for(src, 100))
+		{
+			start_fetch(engine, src);
+		}
+		// start as many sites as the engine has room for
+		while (!draining && !throttled && !engine.full() && fetches->try_pop(src))
+		{
+			start_fetch(engine, src);
+		}
 		// download site data
-		string body = curl_url(src.source);
-		// check curl_url() result for errors (timeout)
-		while (body.compare("failure") == 0)
-		{
-			body = curl_url(src.source);
-		}
-		// create data object for parses queue
-		parse_data d;
-		d.fetchtime = f_time;
-		d.source = src.source;
-		d.body = body;
-		d.run_num = src.run_num;
-		// lock m_parses mutex
-		unique_lock<mutex> p_lock(m_parses);
-		// push data object to parses queue
-		parses.push(d);
-		// signal on condition variable for m_parses
-		cv_parses.notify_one();
-		// unlock m_parses mutex
-		p_lock.unlock();
+		engine.perform(100);
+		fetch_inflight.fetch_add(engine.inflight() - reported);
+		reported = engine.inflight();
+		curl_transfer done;
+		while (engine.next_done(done))
+		{
+			parse_data d;
+			if (finish_transfer(engine, done, d))
+			{
+				// push data object to parses queue, waiting while it is full
+				parses->push(move(d));
+			}
+		}
 	}
 }
 
-void parse_thread_function()
+void parse_thread_function(int id)
 {
 	/* function to control a parse thread */
 	
-	// continue loop until program ends
+	// continue loop until the pool shrinks below this thread
+	while (!parse_pool->retire(id))
+	{
+		// get data from parses queue
+		parse_data db;
+		if (!parses->pop_for(db, 100))
+		{
+			continue;
+		}
+		parse_pool->busy(parse_body(db));
+	}
+}
+
+void worker_thread_function(int id)
+{
+	/* function to control a worker of the work-stealing executor: it fetches
+	 like a fetch thread and counts the bodies it fetched itself, newest first,
+	 stealing the oldest bodies of other workers when it has none */
+	
+	CurlMulti engine(cfg.max_inflight, cfg.html_text, cfg.compression);
+	int reported = 0;
 	while (1)
 	{
-		// lock m_parses mutex
-		unique_lock<mutex> p_lock(m_parses);
+		fetch_data src;
 		parse_data db;
-		// get data from parses queue
-		cv_parses.wait(p_lock, []{return !parses.empty();});
-		db = parses.front();
-		parses.pop();
-		// unlock m_parses mutex
-		p_lock.unlock();
-		// parse data for each search term
-		for (string target : search_terms)
-		{
-			// count occurences of term
-			int count = count_occurrences(db.body, target);
-			// format lookup time
-			struct tm * datetm = gmtime(&(db.fetchtime));
-			string timedate(asctime(datetm));
-			timedate.erase(remove(timedate.begin(),timedate.end(), '\n'), timedate.end());
-			// lock results mutex
-			unique_lock<mutex> r_lock(m_results);
-			// create stream to output file
-			ofstream outfile;
-			string filename = to_string(db.run_num) + ".csv";
-			outfile.open(filename, ofstream::out | ofstream::app);
-			// output results
-			outfile << timedate << "," << target << "," << db.source << "," << count << endl;
-			// close output file
-			outfile.close();
-			// unlock results mutex
-			r_lock.unlock();
-		}
-		
+		bool have = tasks->pop(id, db);
+		// new sites only once this worker's own bodies are counted, which
+		// bounds the bodies held to the transfers in flight
+		if (!have)
+		{
+			// no new sites while bodies are over the memory budget
+			while (!engine.full() && !BodyBuffer::over_budget() && fetches->try_pop(src))
+			{
+				start_fetch(engine, src);
+			}
+			have = tasks->steal(id, db);
+		}
+		// at shutdown leave with no bodies left and the transfers finished
+		// or out of time
+		if (!have && stopping.load() && (engine.inflight() == 0 || past_deadline()))
+		{
+			return;
+		}
+		if (have)
+		{
+			// keep the transfers moving between bodies
+			engine.perform(0);
+		}
+		else if (engine.inflight() > 0)
+		{
+			// wake up often enough to notice work to steal
+			engine.perform(10);
+		}
+		else if (BodyBuffer::over_budget())
+		{
+			BodyBuffer::wait_for_budget(10);
+		}
+		else if (fetches->pop_for(src, 10))
+		{
+			start_fetch(engine, src);
+		}
+		fetch_inflight.fetch_add(engine.inflight() - reported);
+		reported = engine.inflight();
+		curl_transfer done;
+		while (engine.next_done(done))
+		{
+			parse_data d;
+			if (finish_transfer(engine, done, d))
+			{
+				tasks->push(id, move(d));
+			}
+		}
+		if (have)
+		{
+			parse_body(db);
+		}
 	}
 }
 
-void signalHandler( int signum )
+void write_stats(const string &filename, double seconds, double bytes_per_s, double results_per_s)
 {
-	/* exits gracefully after current queues have been emptied */
+	/* replaces the stats file with a snapshot of the metrics */
 	
-	// let queues empty
-	while (!fetches.empty())
+	ostringstream out;
+	out << "uptime_s " << (long)seconds << "\n";
+	out << "fetch_queue_depth " << fetches->size() << "\n";
+	out << "parse_queue_depth " << parses->size() + tasks->size() << "\n";
+	out << "fetch_threads " << fetch_pool->size() << "\n";
+	out << "parse_threads " << parse_pool->size() << "\n";
+	if (cfg.executor.compare("steal") == 0)
 	{
-		continue;
+		out << "workers " << cfg.num_workers << "\n";
 	}
-	while (!parses.empty())
+	out << "fetches_ok " << metrics.fetches_ok.load() << "\n";
+	out << "fetches_failed " << metrics.fetches_failed.load() << "\n";
+	out << "bytes_total " << metrics.bytes.load() << "\n";
+	out << "bytes_per_s " << (long)bytes_per_s << "\n";
+	out << "bytes_decoded_total " << metrics.decoded_bytes.load() << "\n";
+	out << "body_memory_bytes " << BodyBuffer::in_memory() << "\n";
+	out << "bodies_spilled_total " << BodyBuffer::spilled() << "\n";
+	out << "results_written " << metrics.results_written.load() << "\n";
+	out << "results_per_s " << (long)results_per_s << "\n";
+	metrics.dns.report(out, "fetch_dns_us");
+	metrics.connect.report(out, "fetch_connect_us");
+	metrics.tls.report(out, "fetch_tls_us");
+	metrics.ttfb.report(out, "fetch_ttfb_us");
+	metrics.transfer.report(out, "fetch_transfer_us");
+	metrics.queue_wait.report(out, "parse_queue_wait_us");
+	metrics.parse.report(out, "parse_us");
+	metrics.cycle.report(out, "cycle_ms");
+	// readers never see a half written file
+	string tmp = filename + ".tmp";
+	ofstream outfile(tmp, ofstream::trunc);
+	outfile << out.str();
+	outfile.close();
+	if (outfile.good())
 	{
-		continue;
+		rename(tmp.c_str(), filename.c_str());
 	}
-	// sleep for 1 second to ensure parse threads are finished
-	this_thread::sleep_for(chrono::milliseconds(1));
-	// ensure no files are being edited
-	unique_lock<mutex> r_lock(m_results);
+}
+
+void stats_thread_function()
+{
+	/* function to control the stats thread */
 	
-	exit(0);
+	chrono::steady_clock::time_point last = started_at;
+	uint64_t last_bytes = 0, last_results = 0;
+	while (!wait_for_stop(chrono::seconds(cfg.stats_period)))
+	{
+		// rates are over the last period
+		chrono::steady_clock::time_point now = chrono::steady_clock::now();
+		double elapsed = chrono::duration<double>(now - last).count();
+		uint64_t bytes = metrics.bytes.load();
+		uint64_t results = metrics.results_written.load();
+		write_stats(cfg.stats_file, chrono::duration<double>(now - started_at).count(),
+			(bytes - last_bytes) / elapsed, (results - last_results) / elapsed);
+		last = now;
+		last_bytes = bytes;
+		last_results = results;
+	}
 }
 
-int main( int argc, char * argv[] )
+void autoscale_thread_function()
 {
-	/* main program execution */
+	/* grows a pool that is falling behind and shrinks one that sits idle,
+	 one thread at a time */
 	
-	// validate number of command line inputs
-	if(argc != 2)
+	int fetch_late = 0, fetch_idle = 0, parse_late = 0, parse_idle = 0;
+	while (!wait_for_stop(chrono::seconds(1)))
 	{
-		cerr << "Error: Incorrect Arguments" << endl;
-		cerr << "Usage:" << endl << "\t./site-tester config-file";
-		return 1;
+		int nf = fetch_pool->size();
+		int np = parse_pool->size();
+		// a site whose host has a free slot but no thread to start it is past
+		// its deadline; more fetch threads only help if parsing keeps up
+		bool parses_full = parses->size() >= parses->capacity();
+		fetch_late = (fetches->ready() > 0 && !parses_full) ? fetch_late + 1 : 0;
+		fetch_idle = (fetches->ready() == 0 && fetch_inflight.load() < (nf - 1) * cfg.max_inflight / 2)
+			? fetch_idle + 1 : 0;
+		if (fetch_late >= 2 && nf < cfg.max_fetch)
+		{
+			fetch_pool->resize(nf + 1);
+			fetch_late = 0;
+		}
+		else if (fetch_idle >= 5 && nf > cfg.min_fetch)
+		{
+			fetch_pool->resize(nf - 1);
+			fetch_idle = 0;
+		}
+		// bodies waiting while every parse thread is busy
+		double util = parse_pool->utilization();
+		parse_late = (!parses->empty() && util > 0.75) ? parse_late + 1 : 0;
+		parse_idle = (parses->empty() && util < 0.25) ? parse_idle + 1 : 0;
+		if (parse_late >= 2 && np < cfg.max_parse)
+		{
+			parse_pool->resize(np + 1);
+			parse_late = 0;
+		}
+		else if (parse_idle >= 5 && np > cfg.min_parse)
+		{
+			parse_pool->resize(np - 1);
+			parse_idle = 0;
+		}
 	}
+}
+
+vector<site_entry> shard_sites(const vector<site_entry> &all)
+{
+	/* the sites this process fetches: all of them, or in a shard worker
+	 those whose host hashes to its shard */
 	
-	/* --------------- parse for input data --------------- */
+	if (cfg.shard_index < 0)
+	{
+		return all;
+	}
+	ShardRing ring(cfg.shard_count);
+	vector<site_entry> mine;
+	for (const site_entry &site : all)
+	{
+		if (ring.shard_of(url_host(site.url)) == cfg.shard_index)
+		{
+			mine.push_back(site);
+		}
+	}
+	return mine;
+}
+
+void load_terms()
+{
+	/* compiles the search terms file into a new matcher and swaps it in;
+	 transfers and bodies already being counted keep the one they started with */
 	
-	ifstream infile(argv[1]);
-	string line,delimeter;
-	// parameter labels
-	string period = "PERIOD_FETCH";
-	string numf = "NUM_FETCH";
-	string nump = "NUM_PARSE";
-	string sf = "SEARCH_FILE";
-	string sif = "SITE_FILE";
-	// default parameters
-	int per = 180; // seconds between queue fills
-	int nf = 1; // fetch threads
-	int np = 1; // parse threads
-	string searf = "Search.txt"; // search terms file
-	string sitf = "Sites.txt"; // searchable sites file
-	// loop over configuration file for parameters
-	while(getline(infile,line))
-	{
-		delimeter="=";
-		// period
-		if(period.compare(line.substr(0,line.find(delimeter)))==0)
-		{
-			per=stoi(line.substr(line.find(delimeter)+1));
-			// enforce sensible input
-			if (per <= 0 || per > 500)
-			{
-				per = 180;
-			}
+	shared_ptr<Matcher> m = make_shared<Matcher>();
+	for (const string &error : m->compile(parseFile(cfg.search_file), cfg.simd_max_terms))
+	{
+		cerr << "Error: bad search term " << error << ", searching for the line as it is" << endl;
+	}
+	// the same terms again, keep the warm DFA caches
+	shared_ptr<const Matcher> old = current_matcher();
+	if (old != NULL && old->fingerprint() == m->fingerprint())
+	{
+		return;
+	}
+	atomic_store(&matcher, shared_ptr<const Matcher>(m));
+}
+
+void reload(bool terms, bool site_list)
+{
+	/* reads input files again while the pipeline keeps running; a file that
+	 cannot be read leaves the old version in place */
+	
+	unique_lock<mutex> lock(m_reload);
+	if (terms)
+	{
+		if (file_exists(cfg.search_file))
+		{
+			load_terms();
 		}
-		// number of fetch threads
-		else if(numf.compare(line.substr(0,line.find(delimeter)))==0)
+		else
 		{
-			nf=stoi(line.substr(line.find(delimeter)+1));
-			// enforce sensible input
-			if (nf <= 0 || nf > 100)
-			{
-				nf = 1;
-			}
+			cerr << "Error: cannot reload " << cfg.search_file << ", keeping the old search terms" << endl;
 		}
-		// number of parse threads
-		else if(nump.compare(line.substr(0,line.find(delimeter)))==0)
+	}
+	if (site_list)
+	{
+		if (file_exists(cfg.site_file))
 		{
-			np=stoi(line.substr(line.find(delimeter)+1));
-			// enforce sensible input
-			if (np <= 0 || nf > 100)
-			{
-				np = 1;
-			}
+			// sites still listed keep their deadlines, retries stay queued
+			scheduler->set_sites(shard_sites(parseSites(cfg.site_file, cfg.period)));
+		}
+		else
+		{
+			cerr << "Error: cannot reload " << cfg.site_file << ", keeping the old sites" << endl;
+		}
+	}
+}
+
+void watch_thread_function()
+{
+	/* reloads an input file soon after it has been rewritten or replaced */
+	
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0)
+	{
+		cerr << "Error: cannot watch " << cfg.search_file << " and " << cfg.site_file << endl;
+		return;
+	}
+	// files are often replaced by renaming a new one over them, so watch
+	// the directories they are in
+	struct watched
+	{
+		int wd;
+		string name;
+		bool terms;
+	};
+	vector<watched> files;
+	for (const string &path : {cfg.search_file, cfg.site_file})
+	{
+		string::size_type slash = path.rfind('/');
+		string dir = slash == string::npos ? "." : path.substr(0, slash + 1);
+		watched w;
+		w.wd = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+		w.name = slash == string::npos ? path : path.substr(slash + 1);
+		w.terms = files.empty();
+		files.push_back(w);
+	}
+	alignas(struct inotify_event) char events[4096];
+	bool terms = false, site_list = false;
+	while (1)
+	{
+		// after a change wait for a quiet moment, so a file written in
+		// pieces is read whole
+		struct pollfd p = {fd, POLLIN, 0};
+		int ready = poll(&p, 1, (terms || site_list) ? 200 : -1);
+		if (ready == 0)
+		{
+			reload(terms, site_list);
+			terms = site_list = false;
+			continue;
 		}
-		// search terms file name
-		else if(sf.compare(line.substr(0,line.find(delimeter)))==0)
+		ssize_t n = ready > 0 ? read(fd, events, sizeof(events)) : -1;
+		if (n < 0 && errno == EINTR)
 		{
-			searf=line.substr(line.find(delimeter)+1);
+			continue;
 		}
-		// searchable sites file name
-		else if(sif.compare(line.substr(0,line.find(delimeter)))==0)
+		if (n <= 0)
 		{
-			sitf=line.substr(line.find(delimeter)+1);
+			cerr << "Error: stopped watching the input files" << endl;
+			close(fd);
+			return;
 		}
+		for (char *e = events; e < events + n; )
+		{
+			struct inotify_event *event = (struct inotify_event *)e;
+			for (const watched &w : files)
+			{
+				if (event->len > 0 && event->wd == w.wd && w.name.compare(event->name) == 0)
+				{
+					(w.terms ? terms : site_list) = true;
+				}
+			}
+			e += sizeof(struct inotify_event) + event->len;
+		}
+	}
+}
+
+void signal_thread_function(sigset_t signals)
+{
+	/* reloads the input files on SIGHUP; any other signal stops the
+	 producers, and everything else drains in main */
+	
+	int signum;
+	while (sigwait(&signals, &signum) == 0 && signum == SIGHUP)
+	{
+		reload(true, true);
+	}
+	{
+		unique_lock<mutex> lock(m_stop);
+		shutdown_deadline = chrono::steady_clock::now() + chrono::seconds(cfg.shutdown_timeout);
+		stopping = true;
+	}
+	cv_stop.notify_all();
+	// no more sites are queued or started
+	scheduler->stop();
+	fetches->close();
+}
+
+int main( int argc, char * argv[] )
+{
+	/* main program execution */
+	
+	// validate number of command line inputs
+	if(argc != 2)
+	{
+		cerr << "Error: Incorrect Arguments" << endl;
+		cerr << "Usage:" << endl << "\t./site-tester config-file";
+		return 1;
 	}
 	
+	/* --------------- parse for input data --------------- */
+	
+	cfg = parseConfig(argv[1]);
+	string searf = cfg.search_file; // search terms file
+	string sitf = cfg.site_file; // searchable sites file
+	int per = cfg.period; // seconds between queue fills
+	int nf = cfg.num_fetch; // fetch threads
+	int np = cfg.num_parse; // parse threads
+	
 	// ensure specified search and sites files exist
 	if (!file_exists(searf))
 	{
@@ -261,96 +737,175 @@ int main( int argc, char * argv[] )
 		exit(1);
 	}
 	
-	// parse search terms file into search_terms vector
-	search_terms = parseFile(searf);
-	// parse sites file into sites vector
-	sites = parseFile(sitf);
+	// split over worker processes: this one only starts and merges them
+	if (cfg.shard_index >= cfg.shard_count)
+	{
+		cerr << "Error: SHARD_INDEX must be below SHARD_COUNT" << endl;
+		exit(1);
+	}
+	if (cfg.shard_count > 1 && cfg.shard_index < 0)
+	{
+		return run_coordinator(cfg, argv[1]);
+	}
+	
+	// compile the search terms file into the first matcher
+	load_terms();
+	// pick up what earlier runs learned about the sites
+	if (cfg.cache && !cfg.cache_file.empty())
+	{
+		cache.load(cfg.cache_file);
+	}
+	// parse sites file into sites vector, keeping this shard's
+	vector<site_entry> sites = shard_sites(parseSites(sitf, per));
+	
+	// libcurl must be initialised once before any threads use it
+	curl_global_init(CURL_GLOBAL_ALL);
+	// connections, DNS and TLS sessions are kept across fetch cycles
+	long max_age = cfg.conn_max_age > 0 ? cfg.conn_max_age : 2 * per;
+	curl_share_setup(cfg.dns_cache_timeout, max_age);
+	
+	// every thread inherits a mask blocking the shutdown and reload
+	// signals, so only the signal thread ever sees them
+	sigset_t shutdown_signals;
+	sigemptyset(&shutdown_signals);
+	sigaddset(&shutdown_signals, SIGINT);
+	sigaddset(&shutdown_signals, SIGTERM);
+	sigaddset(&shutdown_signals, SIGHUP);
+	pthread_sigmask(SIG_BLOCK, &shutdown_signals, NULL);
+	
+	/* --------------- create queues and threads --------------- */
+	
+	// bodies in memory over all fetch and parse threads
+	BodyBuffer::set_limits((size_t)cfg.memory_budget_mb << 20, (size_t)cfg.body_spill_mb << 20);
+	
+	bool write_csv = cfg.output_format.compare("binary") != 0;
+	string log_prefix = cfg.output_format.compare("csv") != 0 ? cfg.result_log : "";
+	scheduler = new Scheduler(per, cfg.spread_fetches, cfg.run_start);
+	retries = new RetryPolicy(cfg.retry_max, cfg.retry_base_ms, cfg.retry_cap_ms,
+		cfg.breaker_threshold, cfg.breaker_cooldown);
+	writer = new ResultWriter(cfg.flush_bytes, cfg.flush_ms, write_csv, log_prefix);
+	if (!writer->good())
+	{
+		cerr << "Error: " << cfg.result_log << " cannot be opened as the results log" << endl;
+		exit(1);
+	}
+	fetches = new HostQueue(cfg.fetch_queue_capacity, cfg.max_per_host);
+	parses = new MPMCQueue<parse_data>(cfg.parse_queue_capacity, cfg.queue_spin);
 	
-	/* --------------- create threads --------------- */
 	
-	// fetch threads
-	thread fetch_threads[nf];
-	for (int i=0; i < nf; i++)
+	fetch_pool = new ThreadPool(fetch_thread_function);
+	parse_pool = new ThreadPool(parse_thread_function);
+	tasks = new StealQueues<parse_data>(cfg.num_workers);
+	vector<thread> workers;
+	thread autoscaler, stats;
+	started_at = chrono::steady_clock::now();
+	if (cfg.executor.compare("steal") == 0)
+	{
+		// one pool of workers that both fetch and parse
+		for (int i=0; i < cfg.num_workers; i++)
+		{
+			workers.push_back(thread(worker_thread_function, i));
+		}
+	}
+	else
 	{
-		fetch_threads[i] = thread(fetch_thread_function);
+		// fetch threads
+		fetch_pool->resize(nf);
+		// parse threads
+		parse_pool->resize(np);
+		// pool size controller
+		if (cfg.autoscale)
+		{
+			autoscaler = thread(autoscale_thread_function);
+		}
 	}
-	// parse threads
-	thread parse_threads[np];
-	for (int i=0; i<np; i++)
+	// stats thread
+	if (!cfg.stats_file.empty())
 	{
-		parse_threads[i] = thread(parse_thread_function);
+		stats = thread(stats_thread_function);
 	}
 	
 	/* --------------- catch interrupt signals to exit gracefully --------------- */
 	
-	signal(SIGINT, signalHandler);
-	signal(SIGHUP, signalHandler);
+	thread(signal_thread_function, shutdown_signals).detach();
+	// reload the input files when they change
+	if (cfg.watch_files)
+	{
+		thread(watch_thread_function).detach();
+	}
 	
-	/* --------------- fill queue every (per) seconds --------------- */
+	/* --------------- queue each site when its deadline comes up --------------- */
 	
-	// create timer variables
-	time_t old_time;
-	time_t c_time;
-	// fill queue
+	scheduler->set_sites(sites);
 	fetch_data fd;
-	int rn = 1;
-	// lock results mutex
-	unique_lock<mutex> r_lock(m_results);
-	// create stream to output file
-	ofstream outfile;
-	string filename = to_string(rn) + ".csv";
-	outfile.open(filename, ofstream::out | ofstream::app);
-	// output results
-	outfile << "Time,Phrase,Site,Count" << endl;
-	// close output file
-	outfile.close();
-	// unlock results mutex
-	r_lock.unlock();
-	for (string source : sites)
-	{
-		fd.source = source;
-		fd.run_num = rn;
-		fetches.push(fd);
-		// signal condition variable
-		cv_fetches.notify_one();
-	}
-	// get time
-	time(&old_time);
-	// loop to continue filling queue until program ends
-	while (1)
+	int rn = 0;
+	// sleep until the next site is due
+	while (scheduler->next(fd))
 	{
-		// get current time
-		time(&c_time);
-		// fill queue again if (per) seconds has passed
-		if (difftime(c_time,old_time) > (float)per)
+		// joining runs that began before this process, e.g. as a shard
+		if (rn == 0)
+		{
+			rn = fd.run_num - 1;
+		}
+		// start output files for any runs that have begun
+		while (rn < fd.run_num)
 		{
-			// increment run number
 			rn++;
-			// lock results mutex
-			r_lock.lock();
-			// create stream to output file
-			ofstream outfile;
-			string filename = to_string(rn) + ".csv";
-			outfile.open(filename, ofstream::out | ofstream::app);
-			// output results
-			outfile << "Time,Phrase,Site,Count" << endl;
-			// close output file
-			outfile.close();
-			// unlock results mutex
-			r_lock.unlock();
-			// fill queue
-			for (string source : sites)
+			writer->begin_run(rn);
+			// every site of the last run has been queued
+			metrics.run_closed(rn - 1);
+			metrics.run_started(rn);
+			// keep the cache on disk for the next start
+			if (cfg.cache && !cfg.cache_file.empty() && rn > 1)
 			{
-				fd.source = source;
-				fd.run_num = rn;
-				fetches.push(fd);
-				// signal condition variable
-				cv_fetches.notify_one();
+				cache.save(cfg.cache_file);
 			}
-			// get time
-			time(&old_time);
 		}
+		// retries were counted when first queued
+		if (fd.attempts == 0)
+		{
+			metrics.fetch_queued(fd.run_num);
+		}
+		fetches->push(fd);
+	}
+	
+	/* --------------- drain the pipeline once a signal stops the scheduler --------------- */
+	
+	// the pool sizes stay put from here on
+	if (autoscaler.joinable())
+	{
+		autoscaler.join();
+	}
+	// fetchers finish their transfers, or abandon them at the deadline
+	for (thread &t : workers)
+	{
+		t.join();
+	}
+	fetch_pool->join();
+	// bodies already fetched are still counted
+	while (!parses->empty())
+	{
+		this_thread::sleep_for(chrono::milliseconds(10));
+	}
+	parse_pool->join();
+	if (stats.joinable())
+	{
+		stats.join();
+	}
+	// write out buffered results
+	writer->stop();
+	if (cfg.cache && !cfg.cache_file.empty())
+	{
+		cache.save(cfg.cache_file);
+	}
+	// a last snapshot with rates over the whole run
+	if (!cfg.stats_file.empty())
+	{
+		double seconds = chrono::duration<double>(chrono::steady_clock::now() - started_at).count();
+		write_stats(cfg.stats_file, seconds, metrics.bytes.load() / seconds,
+			metrics.results_written.load() / seconds);
 	}
+	curl_share_teardown();
 	
 	return 0;
 }
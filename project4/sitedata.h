@@ -0,0 +1,45 @@
+// sitedata.h
+
+#ifndef SITEDATA_H
+#define SITEDATA_H
+
+#include <string>
+#include <chrono>
+#include <time.h>
+
+#include "bodybuffer.h"
+
+using namespace std;
+
+// a line of the sites file: url and optional fetch period in seconds
+struct site_entry
+{
+	string url;
+	int period;
+};
+
+// data structure for queues
+struct fetch_data
+{
+	int run_num;
+	string source;
+	// failed attempts so far
+	int attempts = 0;
+	// validators from the last fetch, sent as a conditional request
+	string if_none_match;
+	string if_modified_since;
+};
+struct parse_data
+{
+	time_t fetchtime;
+	string source;
+	BodyBuffer body;
+	int run_num;
+	// validators returned with the body
+	string etag;
+	string last_modified;
+	// when the body was queued, for the queue wait metric
+	chrono::steady_clock::time_point queued;
+};
+
+#endif
@@ -0,0 +1,92 @@
+// stealqueues.h
+
+#ifndef STEALQUEUES_H
+#define STEALQUEUES_H
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <atomic>
+#include <stddef.h>
+
+using namespace std;
+
+// One deque per worker.  A worker pushes and pops at the front of its own
+// deque, so it gets back the item it made last while that is still in its
+// cache; idle workers steal the oldest item from the back of somebody else's.
+// Each deque has its own lock, which the owner almost never has to share.
+template <typename T>
+class StealQueues
+{
+public:
+	StealQueues(int workers)
+	{
+		queues.reset(new worker_queue[workers]);
+		this->workers = workers;
+		count.store(0, memory_order_relaxed);
+	}
+
+	void push(int worker, T item)
+	{
+		worker_queue &q = queues[worker];
+		lock_guard<mutex> lock(q.m);
+		q.items.push_front(move(item));
+		count.fetch_add(1, memory_order_relaxed);
+	}
+
+	// newest item of the worker's own deque, false when empty
+	bool pop(int worker, T &item)
+	{
+		worker_queue &q = queues[worker];
+		lock_guard<mutex> lock(q.m);
+		if (q.items.empty())
+		{
+			return false;
+		}
+		item = move(q.items.front());
+		q.items.pop_front();
+		count.fetch_sub(1, memory_order_relaxed);
+		return true;
+	}
+
+	// oldest item of another worker's deque, trying the next worker first
+	bool steal(int thief, T &item)
+	{
+		// skip the locks when there is nothing anywhere
+		if (count.load(memory_order_relaxed) == 0)
+		{
+			return false;
+		}
+		for (int i = 1; i < workers; i++)
+		{
+			worker_queue &q = queues[(thief + i) % workers];
+			lock_guard<mutex> lock(q.m);
+			if (!q.items.empty())
+			{
+				item = move(q.items.back());
+				q.items.pop_back();
+				count.fetch_sub(1, memory_order_relaxed);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// approximate number of items over all workers
+	size_t size() const { return count.load(memory_order_relaxed); }
+
+private:
+	struct worker_queue
+	{
+		mutex m;
+		deque<T> items;
+		// keep neighbouring locks off each other's cache line
+		char pad[64];
+	};
+
+	unique_ptr<worker_queue[]> queues;
+	int workers;
+	atomic<size_t> count;
+};
+
+#endif
@@ -0,0 +1,90 @@
+// threadpool.cpp
+
+#include <thread>
+#include <mutex>
+#include "threadpool.h"
+
+using namespace std;
+
+ThreadPool::ThreadPool(function<void(int)> worker)
+{
+	this->worker = worker;
+	target = 0;
+	busy_us.store(0);
+	last_sample = chrono::steady_clock::now();
+}
+
+ThreadPool::~ThreadPool()
+{
+	join();
+}
+
+void ThreadPool::join()
+{
+	resize(0);
+	// workers take the lock to retire, so join without it
+	for (slot &s : slots)
+	{
+		if (s.t.joinable())
+		{
+			s.t.join();
+		}
+	}
+}
+
+void ThreadPool::resize(int n)
+{
+	unique_lock<mutex> lock(m_slots);
+	target = n < 0 ? 0 : n;
+	while ((int)slots.size() < target)
+	{
+		slots.emplace_back();
+	}
+	for (int id = 0; id < target; id++)
+	{
+		slot &s = slots[id];
+		// a worker that has not seen it was retired just carries on
+		if (s.running)
+		{
+			continue;
+		}
+		// a retired worker has already left its loop
+		if (s.t.joinable())
+		{
+			s.t.join();
+		}
+		s.running = true;
+		s.t = thread(worker, id);
+	}
+}
+
+int ThreadPool::size()
+{
+	unique_lock<mutex> lock(m_slots);
+	return target;
+}
+
+bool ThreadPool::retire(int id)
+{
+	unique_lock<mutex> lock(m_slots);
+	if (id < target)
+	{
+		return false;
+	}
+	slots[id].running = false;
+	return true;
+}
+
+double ThreadPool::utilization()
+{
+	chrono::steady_clock::time_point now = chrono::steady_clock::now();
+	double elapsed = chrono::duration<double, micro>(now - last_sample).count();
+	last_sample = now;
+	uint64_t busy = busy_us.exchange(0, memory_order_relaxed);
+	int n = size();
+	if (n == 0 || elapsed <= 0)
+	{
+		return 0;
+	}
+	return busy / (elapsed * n);
+}
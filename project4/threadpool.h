@@ -0,0 +1,54 @@
+// threadpool.h
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <chrono>
+#include <functional>
+#include <stdint.h>
+
+using namespace std;
+
+// Worker threads whose number can change while they run.  Each worker gets an
+// id and must call retire(id) between jobs; when the pool has shrunk below
+// its id, retire returns true and the worker returns.  Workers also report
+// the time they spend busy so a controller can see how loaded the pool is.
+class ThreadPool
+{
+public:
+	ThreadPool(function<void(int)> worker);
+	~ThreadPool();
+
+	// starts workers or asks the highest numbered ones to retire
+	void resize(int n);
+	int size();
+	// asks every worker to retire and waits until they have returned
+	void join();
+
+	// called by worker id between jobs, true when it should return
+	bool retire(int id);
+	// a worker spent us microseconds doing work
+	void busy(uint64_t us) { busy_us.fetch_add(us, memory_order_relaxed); }
+	// fraction of the pool's time spent busy since the last call
+	double utilization();
+
+private:
+	struct slot
+	{
+		thread t;
+		bool running = false;
+	};
+
+	function<void(int)> worker;
+	mutex m_slots;
+	deque<slot> slots;
+	int target;
+	atomic<uint64_t> busy_us;
+	chrono::steady_clock::time_point last_sample;
+};
+
+#endif